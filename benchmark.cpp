@@ -0,0 +1,387 @@
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "poly.h"
+#include "poly_modulus.h"
+
+// Benchmark suite, separate from the checks of main.cpp. Every operation is
+// swept over the degrees with each of its algorithms, each case is warmed up
+// then timed over several samples of enough iterations to last at least
+// minSampleNs, and the statistics of the ns per operation are printed as
+// CSV or JSON.
+//
+//   poly_benchmark [--format csv|json] [--filter text] [--max-degree n]
+//                  [--samples n] [--min-sample-ns n]
+
+struct Options {
+    bool json = false;
+    std::string filter;
+    unsigned maxDegree = 1 << 18;
+    unsigned samples = 11;
+    long minSampleNs = 2000000;
+};
+
+struct Case {
+    std::string operation;
+    std::string algorithm;
+    unsigned degree;
+    // Runs the operation once, returns something depending on the result
+    std::function<int()> run;
+};
+
+struct Stats {
+    unsigned iterations;
+    double min;
+    double median;
+    double mean;
+    double stddev;
+};
+
+static long nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Accumulates the results so the operations can't be optimized away
+static volatile int sink = 0;
+
+static long timeIterations(const Case& c, unsigned iterations) {
+    int accumulator = 0;
+    long start = nowNs();
+    for (unsigned i = 0; i < iterations; i++) {
+        accumulator += c.run();
+    }
+    long end = nowNs();
+    sink = sink + accumulator;
+    return end - start;
+}
+
+// Doubles the iterations until a run lasts minSampleNs, which is also the
+// warmup, then takes the samples with that many iterations
+static Stats measure(const Case& c, const Options& options) {
+    unsigned iterations = 1;
+    while (timeIterations(c, iterations) < options.minSampleNs and iterations < (1u << 30)) {
+        iterations *= 2;
+    }
+
+    std::vector<double> samples;
+    for (unsigned i = 0; i < options.samples; i++) {
+        samples.push_back((double) timeIterations(c, iterations) / iterations);
+    }
+    std::sort(samples.begin(), samples.end());
+
+    Stats stats;
+    stats.iterations = iterations;
+    stats.min = samples.front();
+    stats.median = samples[samples.size() / 2];
+    stats.mean = 0;
+    for (double sample : samples) {
+        stats.mean += sample;
+    }
+    stats.mean /= samples.size();
+    stats.stddev = 0;
+    for (double sample : samples) {
+        stats.stddev += (sample - stats.mean) * (sample - stats.mean);
+    }
+    stats.stddev = std::sqrt(stats.stddev / samples.size());
+    return stats;
+}
+
+/*****************************************************************************\
+|*                                   Cases                                   *|
+\*****************************************************************************/
+
+static std::default_random_engine generator;
+
+// The cases keep their operands alive through shared_ptrs captured by run
+template<typename T>
+static std::shared_ptr<T> shared(T value) {
+    return std::make_shared<T>(std::move(value));
+}
+
+static void addMultiplyCases(unsigned degree, std::vector<Case>& cases) {
+    auto a = shared(Poly::random(degree, generator));
+    auto b = shared(Poly::random(degree, generator));
+    auto res = shared(Poly());
+
+    if (degree <= 1024) {
+        cases.push_back({"multiply", "naive", degree, [a, b]() {
+            return a->multiplyNaively(*b).degree();
+        }});
+    }
+
+    struct Algorithm {
+        const char* name;
+        Poly::MultiplyThresholds thresholds;
+        unsigned maxDegree;
+    };
+    const Algorithm algorithms[] = {
+        {"basecase", {UINT_MAX, UINT_MAX, UINT_MAX}, 1 << 16},
+        {"karatsuba", Poly::KARATSUBA_ONLY, UINT_MAX},
+        {"toom3", {Poly::multiplyThresholds.karatsuba, 7, UINT_MAX}, UINT_MAX},
+        {"fft", {Poly::multiplyThresholds.karatsuba, Poly::multiplyThresholds.toom3, 2}, UINT_MAX},
+        {"default", Poly::multiplyThresholds, UINT_MAX},
+    };
+
+    for (const Algorithm& algorithm : algorithms) {
+        if (degree > algorithm.maxDegree) {
+            continue;
+        }
+        Poly::MultiplyThresholds thresholds = algorithm.thresholds;
+        cases.push_back({"multiply", algorithm.name, degree, [a, b, res, thresholds]() {
+            a->multiply(*b, *res, thresholds);
+            return res->degree();
+        }});
+    }
+
+    cases.push_back({"square", "default", degree, [a, res]() {
+        a->square(*res);
+        return res->degree();
+    }});
+}
+
+static void addLinearCases(unsigned degree, std::vector<Case>& cases) {
+    auto a = shared(Poly::random(degree, generator));
+    auto b = shared(Poly::random(degree, generator));
+    auto res = shared(Poly());
+
+    cases.push_back({"add", "default", degree, [a, b, res]() {
+        a->add(*b, *res);
+        return res->degree();
+    }});
+    cases.push_back({"shift_left", "default", degree, [a, res]() {
+        a->shiftLeft(37, *res);
+        return res->degree();
+    }});
+    cases.push_back({"shift_right", "default", degree, [a, res]() {
+        a->shiftRight(37, *res);
+        return res->degree();
+    }});
+
+    auto hex = shared(std::vector<char>(a->hexSize()));
+    cases.push_back({"to_hex", "default", degree, [a, hex]() {
+        return a->toHex(hex->data()) - hex->data();
+    }});
+    // Printed once, only the parsing is timed
+    auto parsedHex = shared(std::vector<char>(a->hexSize()));
+    a->toHex(parsedHex->data());
+    cases.push_back({"from_hex", "default", degree, [parsedHex, res]() {
+        Poly::fromHex(parsedHex->data(), parsedHex->data() + parsedHex->size(), *res);
+        return res->degree();
+    }});
+
+    // A quarter degree poly added at a middle offset, as in the recombinations
+    auto quarter = shared(Poly::random(degree / 4, generator));
+    cases.push_back({"add_shifted", "shift_then_add", degree, [a, quarter, res, degree]() {
+        quarter->shiftLeft(degree / 2 + 37, *res);
+        res->add(*a, *res);
+        return res->degree();
+    }});
+    cases.push_back({"add_shifted", "default", degree, [a, quarter, res, degree]() {
+        *res = *a;
+        res->addShifted(*quarter, degree / 2 + 37);
+        return res->degree();
+    }});
+}
+
+// An algorithm selected by a threshold of Poly, the quadratic ones are
+// skipped past maxDegree
+struct ThresholdAlgorithm {
+    const char* name;
+    unsigned threshold;
+    unsigned maxDegree;
+};
+
+// Sets one of the thresholds of Poly for its scope, the other cases and the
+// callers get back the previous value whatever happens in between
+class ScopedThreshold {
+    public:
+        ScopedThreshold(unsigned& threshold, unsigned value) : threshold(threshold), saved(threshold) {
+            threshold = value;
+        }
+        ~ScopedThreshold() {
+            this->threshold = this->saved;
+        }
+
+        ScopedThreshold(const ScopedThreshold&) = delete;
+        ScopedThreshold& operator=(const ScopedThreshold&) = delete;
+
+    private:
+        unsigned& threshold;
+        unsigned saved;
+};
+
+// A poly of twice the degree divided by one of the degree
+static void addDivisionCases(unsigned degree, std::vector<Case>& cases) {
+    auto a = shared(Poly::random(2 * degree, generator));
+    auto b = shared(Poly::random(degree, generator));
+    auto q = shared(Poly());
+    auto r = shared(Poly());
+
+    const ThresholdAlgorithm algorithms[] = {
+        {"blocks", UINT_MAX, 1 << 16},
+        {"newton", 0, UINT_MAX},
+        {"default", Poly::newtonDivisionThreshold, UINT_MAX},
+    };
+
+    for (const ThresholdAlgorithm& algorithm : algorithms) {
+        if (degree > algorithm.maxDegree) {
+            continue;
+        }
+        unsigned threshold = algorithm.threshold;
+        cases.push_back({"divide", algorithm.name, degree, [a, b, q, r, threshold]() {
+            ScopedThreshold scoped(Poly::newtonDivisionThreshold, threshold);
+            a->euclidianDivision(*b, *q, *r);
+            return r->degree();
+        }});
+    }
+
+    auto modulus = shared(PolyModulus(*b + Poly::fromInt(1)));
+    auto c = shared(Poly::random(degree - 1, generator));
+    auto res = shared(Poly());
+    cases.push_back({"mulmod", "default", degree, [modulus, c, res]() {
+        modulus->mulmod(*c, *c, *res);
+        return res->degree();
+    }});
+}
+
+static void addGcdCases(unsigned degree, std::vector<Case>& cases) {
+    auto a = shared(Poly::random(degree, generator));
+    auto b = shared(Poly::random(degree, generator));
+
+    const ThresholdAlgorithm algorithms[] = {
+        {"binary", UINT_MAX, 1 << 16},
+        {"half", 0, UINT_MAX},
+        {"default", Poly::halfGcdThreshold, UINT_MAX},
+    };
+
+    for (const ThresholdAlgorithm& algorithm : algorithms) {
+        if (degree > algorithm.maxDegree) {
+            continue;
+        }
+        unsigned threshold = algorithm.threshold;
+        cases.push_back({"gcd", algorithm.name, degree, [a, b, threshold]() {
+            ScopedThreshold scoped(Poly::halfGcdThreshold, threshold);
+            return a->gcd(*b).degree();
+        }});
+    }
+}
+
+/*****************************************************************************\
+|*                                   Output                                  *|
+\*****************************************************************************/
+
+static void printHeader(const Options& options) {
+    if (options.json) {
+        std::cout << "[";
+    } else {
+        std::cout << "operation,algorithm,degree,iterations,min_ns,median_ns,mean_ns,stddev_ns" << std::endl;
+    }
+}
+
+static void printResult(const Case& c, const Stats& stats, bool first, const Options& options) {
+    if (options.json) {
+        std::cout << (first ? "" : ",") << std::endl
+            << "  {\"operation\": \"" << c.operation << "\", \"algorithm\": \"" << c.algorithm
+            << "\", \"degree\": " << c.degree << ", \"iterations\": " << stats.iterations
+            << ", \"min_ns\": " << stats.min << ", \"median_ns\": " << stats.median
+            << ", \"mean_ns\": " << stats.mean << ", \"stddev_ns\": " << stats.stddev << "}" << std::flush;
+    } else {
+        std::cout << c.operation << "," << c.algorithm << "," << c.degree << "," << stats.iterations << ","
+            << stats.min << "," << stats.median << "," << stats.mean << "," << stats.stddev << std::endl;
+    }
+}
+
+static void printFooter(const Options& options) {
+    if (options.json) {
+        std::cout << std::endl << "]" << std::endl;
+    }
+}
+
+// A number up to max, without anything after it
+static bool parseNumber(const std::string& value, unsigned long max, unsigned long& number) {
+    size_t end = 0;
+    try {
+        number = std::stoul(value, &end);
+    } catch (const std::exception&) {
+        return false;
+    }
+    return end == value.size() and number <= max;
+}
+
+static bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 == argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return false;
+        }
+        std::string value = argv[++i];
+
+        if (arg == "--format" and (value == "csv" or value == "json")) {
+            options.json = value == "json";
+        } else if (arg == "--filter") {
+            options.filter = value;
+        } else if (arg == "--max-degree" or arg == "--samples" or arg == "--min-sample-ns") {
+            unsigned long number;
+            if (not parseNumber(value, arg == "--min-sample-ns" ? LONG_MAX : UINT_MAX, number) or
+                    (arg == "--samples" and number == 0)) {
+                std::cerr << "Invalid value for " << arg << " " << value << std::endl;
+                return false;
+            }
+            if (arg == "--max-degree") {
+                options.maxDegree = number;
+            } else if (arg == "--samples") {
+                options.samples = number;
+            } else {
+                options.minSampleNs = number;
+            }
+        } else {
+            std::cerr << "Unknown option " << arg << " " << value << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (not parseOptions(argc, argv, options)) {
+        return 1;
+    }
+
+    std::vector<Case> cases;
+    for (unsigned degree = 16; degree <= options.maxDegree; degree *= 4) {
+        addLinearCases(degree, cases);
+        addMultiplyCases(degree, cases);
+        addDivisionCases(degree, cases);
+        addGcdCases(degree, cases);
+        // The next degree would wrap around past UINT_MAX
+        if (degree > options.maxDegree / 4) {
+            break;
+        }
+    }
+
+    std::stable_sort(cases.begin(), cases.end(), [](const Case& a, const Case& b) {
+        return a.operation < b.operation;
+    });
+
+    printHeader(options);
+    bool first = true;
+    for (const Case& c : cases) {
+        if ((c.operation + "," + c.algorithm).find(options.filter) == std::string::npos) {
+            continue;
+        }
+        printResult(c, measure(c, options), first, options);
+        first = false;
+    }
+    printFooter(options);
+}
@@ -1,7 +1,17 @@
+#include <type_traits>
+
 #include "bit_utils.h"
 
 #define USE_BUILTINS 1
 
+#if defined(__x86_64__) || defined(__i386__)
+    #define USE_CLMUL 1
+    #include <immintrin.h>
+    #include <wmmintrin.h>
+#else
+    #define USE_CLMUL 0
+#endif
+
 int log2_u32(uint32_t v) {
     #if USE_BUILTINS
         if (v == 0) {
@@ -125,3 +135,646 @@ uint32_t convolution_16_32(uint16_t a, uint16_t b) {
 
     return interleave_16_32(resEven, resOdd);
 }
+
+// Karatsuba on the 32 bits halves
+void convolution_64_128(uint64_t a, uint64_t b, uint64_t& high, uint64_t& low) {
+    uint32_t a1 = a >> 32;
+    uint32_t a0 = a & 0xFFFFFFFF;
+
+    uint32_t b1 = b >> 32;
+    uint32_t b0 = b & 0xFFFFFFFF;
+
+    uint64_t c2 = convolution_32_64(a1, b1);
+    uint64_t c0 = convolution_32_64(a0, b0);
+    uint64_t c1 = convolution_32_64(a1 ^ a0, b1 ^ b0) ^ c2 ^ c0;
+
+    high = c2 ^ (c1 >> 32);
+    low = c0 ^ (c1 << 32);
+}
+
+// Windowed comb: the multiples of b by every 4 bits value are tabulated, then
+// a is scanned 4 bits at a time from the top, shifting the accumulator by 4
+// and adding the multiple for each window. The products of the table fit
+// in the result word for the 16 and 32 bits kernels.
+uint32_t convolution_16_32_comb(uint16_t a, uint16_t b) {
+    uint32_t table[16];
+    table[0] = 0;
+    table[1] = b;
+    for (unsigned u = 2; u < 16; u += 2) {
+        table[u] = table[u / 2] << 1;
+        table[u + 1] = table[u] ^ b;
+    }
+
+    uint32_t res = 0;
+    for (int i = 12; i >= 0; i -= 4) {
+        res = (res << 4) ^ table[(a >> i) & 0xF];
+    }
+    return res;
+}
+
+uint64_t convolution_32_64_comb(uint32_t a, uint32_t b) {
+    uint64_t table[16];
+    table[0] = 0;
+    table[1] = b;
+    for (unsigned u = 2; u < 16; u += 2) {
+        table[u] = table[u / 2] << 1;
+        table[u + 1] = table[u] ^ b;
+    }
+
+    uint64_t res = 0;
+    for (int i = 28; i >= 0; i -= 4) {
+        res = (res << 4) ^ table[(a >> i) & 0xF];
+    }
+    return res;
+}
+
+// The multiples of the 64 bits kernel are kept modulo x^64, the bits they
+// lose are the products of the top 3 bits of b with the bits of each window
+// above the bottom one, they are added back to high at the end.
+void convolution_64_128_comb(uint64_t a, uint64_t b, uint64_t& high, uint64_t& low) {
+    uint64_t table[16];
+    table[0] = 0;
+    table[1] = b;
+    for (unsigned u = 2; u < 16; u += 2) {
+        table[u] = table[u / 2] << 1;
+        table[u + 1] = table[u] ^ b;
+    }
+
+    uint64_t h = 0;
+    uint64_t l = table[a >> 60];
+    for (int i = 56; i >= 0; i -= 4) {
+        h = (h << 4) | (l >> 60);
+        l = (l << 4) ^ table[(a >> i) & 0xF];
+    }
+
+    // Bit 64 - j of b times bit k >= j of a window ends up at bit k - j of
+    // the window in high
+    static const uint64_t WINDOW_BITS[3] = {0xEEEEEEEEEEEEEEEE, 0xCCCCCCCCCCCCCCCC, 0x8888888888888888};
+    for (unsigned j = 1; j <= 3; j++) {
+        uint64_t mask = -((b >> (64 - j)) & 1);
+        h ^= ((a & WINDOW_BITS[j - 1]) >> j) & mask;
+    }
+
+    high = h;
+    low = l;
+}
+
+// Bit by bit long division of x^126, kept in (high, low), by b
+uint64_t reciprocal_64(uint64_t b) {
+    uint64_t high = ((uint64_t) 1) << 62;
+    uint64_t low = 0;
+    uint64_t res = 0;
+
+    for (int i = 63; i >= 0; i--) {
+        // The current leading position is 63 + i
+        uint64_t topBit = i == 0 ? (low >> 63) : (high >> (i - 1)) & 1;
+        if (topBit) {
+            res |= ((uint64_t) 1) << i;
+            if (i == 0) {
+                low ^= b;
+            } else {
+                low ^= b << i;
+                high ^= b >> (64 - i);
+            }
+        }
+    }
+
+    return res;
+}
+
+// Newton iteration g <- f * g^2, each step doubles the number of correct bits
+uint64_t series_inverse_64(uint64_t f) {
+    uint64_t g = 1;
+    uint64_t high, low;
+
+    for (int i = 0; i < 6; i++) {
+        fast_square_64_128(g, high, low);
+        fast_convolution_64_128(f, low, high, g);
+    }
+
+    return g;
+}
+
+uint64_t reverse_64(uint64_t v) {
+    v = ((v >> 1) & 0x5555555555555555ull) | ((v & 0x5555555555555555ull) << 1);
+    v = ((v >> 2) & 0x3333333333333333ull) | ((v & 0x3333333333333333ull) << 2);
+    v = ((v >> 4) & 0x0F0F0F0F0F0F0F0Full) | ((v & 0x0F0F0F0F0F0F0F0Full) << 4);
+    return __builtin_bswap64(v);
+}
+
+// Bytes with their bits spread to the even positions
+struct SpreadTable {
+    SpreadTable() {
+        for (unsigned i = 0; i < 256; i++) {
+            values[i] = interleave_16_32(i, 0);
+        }
+    }
+
+    uint16_t values[256];
+};
+
+static const SpreadTable spreadTable;
+
+void square_64_128(uint64_t a, uint64_t& high, uint64_t& low) {
+    low = 0;
+    high = 0;
+    for (unsigned i = 0; i < 4; i++) {
+        low |= ((uint64_t) spreadTable.values[(a >> (8 * i)) & 0xFF]) << (16 * i);
+        high |= ((uint64_t) spreadTable.values[(a >> (32 + 8 * i)) & 0xFF]) << (16 * i);
+    }
+}
+
+uint32_t even_bits_64_32(uint64_t v) {
+    v &= 0x5555555555555555ull;
+    v = (v | (v >> 1)) & 0x3333333333333333ull;
+    v = (v | (v >> 2)) & 0x0F0F0F0F0F0F0F0Full;
+    v = (v | (v >> 4)) & 0x00FF00FF00FF00FFull;
+    v = (v | (v >> 8)) & 0x0000FFFF0000FFFFull;
+    v = (v | (v >> 16)) & 0x00000000FFFFFFFFull;
+    return v;
+}
+
+/*****************************************************************************\
+|*                             Bitsliced kernels                             *|
+\*****************************************************************************/
+
+// The bitsliced code works on lanes of independent bits, uint64_t or a
+// vector of them where element g is the lane of group g of 64 operands
+typedef uint64_t Lanes4 __attribute__((vector_size(32)));
+
+static inline uint64_t getLane(uint64_t v, unsigned) {
+    return v;
+}
+
+static inline uint64_t getLane(const Lanes4& v, unsigned g) {
+    return v[g];
+}
+
+static inline void setLane(uint64_t& v, unsigned, uint64_t value) {
+    v = value;
+}
+
+static inline void setLane(Lanes4& v, unsigned g, uint64_t value) {
+    v[g] = value;
+}
+
+// Swaps the off diagonal blocks of size 32, 16, ... 1 of every diagonal
+// block, on each element of the lanes at once
+template<typename Lane>
+__attribute__((always_inline)) inline void transposeLanes(Lane m[64]) {
+    uint64_t mask = 0x00000000FFFFFFFFull;
+    for (unsigned width = 32; width != 0; width >>= 1, mask ^= mask << width) {
+        for (unsigned i = 0; i < 64; i = (i + width + 1) & ~width) {
+            Lane swapped = ((m[i] >> width) ^ m[i + width]) & mask;
+            m[i] ^= swapped << width;
+            m[i + width] ^= swapped;
+        }
+    }
+}
+
+void transpose_64x64(uint64_t m[64]) {
+    transposeLanes(m);
+}
+
+// res[0, 2N - 1) = a[0, N) * b[0, N) with Karatsuba on the halves down to
+// N = 16, then schoolbook
+template<unsigned N, typename Lane>
+__attribute__((always_inline)) inline void bitslicedProduct(const Lane* a, const Lane* b, Lane* res, std::false_type) {
+    for (unsigned i = 0; i < 2 * N - 1; i++) {
+        res[i] = Lane();
+    }
+    for (unsigned i = 0; i < N; i++) {
+        for (unsigned j = 0; j < N; j++) {
+            res[i + j] ^= a[i] & b[j];
+        }
+    }
+}
+
+template<unsigned N, typename Lane>
+__attribute__((always_inline)) inline void bitslicedProduct(const Lane* a, const Lane* b, Lane* res, std::true_type) {
+    constexpr unsigned H = N / 2;
+    typedef std::integral_constant<bool, (H > 16)> Recurse;
+
+    Lane aSum[H], bSum[H], c1[2 * H - 1];
+    for (unsigned i = 0; i < H; i++) {
+        aSum[i] = a[i] ^ a[H + i];
+        bSum[i] = b[i] ^ b[H + i];
+    }
+
+    // c0 in res[0, 2H - 1), c2 in res[2H, 4H - 1)
+    bitslicedProduct<H>(a, b, res, Recurse());
+    bitslicedProduct<H>(a + H, b + H, res + 2 * H, Recurse());
+    res[2 * H - 1] = Lane();
+    bitslicedProduct<H>(aSum, bSum, c1, Recurse());
+
+    for (unsigned i = 0; i < 2 * H - 1; i++) {
+        c1[i] ^= res[i] ^ res[2 * H + i];
+    }
+    for (unsigned i = 0; i < 2 * H - 1; i++) {
+        res[H + i] ^= c1[i];
+    }
+}
+
+// Up to 64 * Groups products, missing operands are taken as 0
+template<typename Lane, unsigned Groups>
+__attribute__((always_inline)) inline void bitslicedBatch(const uint64_t* a, const uint64_t* b, unsigned n, uint64_t* high, uint64_t* low) {
+    Lane aLanes[64], bLanes[64], product[128];
+
+    for (unsigned g = 0; g < Groups; g++) {
+        for (unsigned i = 0; i < 64; i++) {
+            unsigned index = 64 * g + i;
+            setLane(aLanes[i], g, index < n ? a[index] : 0);
+            setLane(bLanes[i], g, index < n ? b[index] : 0);
+        }
+    }
+    transposeLanes(aLanes);
+    transposeLanes(bLanes);
+
+    bitslicedProduct<64>(aLanes, bLanes, product, std::true_type());
+    product[127] = Lane();
+
+    transposeLanes(product);
+    transposeLanes(product + 64);
+    for (unsigned g = 0; g < Groups; g++) {
+        for (unsigned i = 0; i < 64 and 64 * g + i < n; i++) {
+            low[64 * g + i] = getLane(product[i], g);
+            high[64 * g + i] = getLane(product[64 + i], g);
+        }
+    }
+}
+
+void convolution_64_128_batch(const uint64_t* a, const uint64_t* b, unsigned n, uint64_t* high, uint64_t* low) {
+    for (unsigned i = 0; i < n; i += 64) {
+        bitslicedBatch<uint64_t, 1>(a + i, b + i, n - i, high + i, low + i);
+    }
+}
+
+/*****************************************************************************\
+|*                            Block array kernels                            *|
+\*****************************************************************************/ 
+
+void xor_blocks(const uint64_t* a, const uint64_t* b, unsigned n, uint64_t* dst) {
+    for (unsigned i = 0; i < n; i++) {
+        dst[i] = a[i] ^ b[i];
+    }
+}
+
+void and_blocks(const uint64_t* a, const uint64_t* b, unsigned n, uint64_t* dst) {
+    for (unsigned i = 0; i < n; i++) {
+        dst[i] = a[i] & b[i];
+    }
+}
+
+void or_blocks(const uint64_t* a, const uint64_t* b, unsigned n, uint64_t* dst) {
+    for (unsigned i = 0; i < n; i++) {
+        dst[i] = a[i] | b[i];
+    }
+}
+
+// The vector kernels do the same on the blocks left after their last full vector
+static inline void shiftLeftTail(const uint64_t* src, unsigned n, unsigned shift, uint64_t* dst) {
+    for (unsigned i = n; i > 1; i--) {
+        dst[i - 1] = (src[i - 1] << shift) | (src[i - 2] >> (64 - shift));
+    }
+    if (n != 0) {
+        dst[0] = src[0] << shift;
+    }
+}
+
+static inline void shiftRightTail(const uint64_t* src, unsigned start, unsigned n, unsigned shift, uint64_t* dst) {
+    for (unsigned i = start; i + 1 < n; i++) {
+        dst[i] = (src[i] >> shift) | (src[i + 1] << (64 - shift));
+    }
+    if (start < n) {
+        dst[n - 1] = src[n - 1] >> shift;
+    }
+}
+
+void shift_left_blocks(const uint64_t* src, unsigned n, unsigned shift, uint64_t* dst) {
+    shiftLeftTail(src, n, shift, dst);
+}
+
+void shift_right_blocks(const uint64_t* src, unsigned n, unsigned shift, uint64_t* dst) {
+    shiftRightTail(src, 0, n, shift, dst);
+}
+
+/*****************************************************************************\
+|*                          Hardware carry-less kernels                      *|
+\*****************************************************************************/ 
+
+#if USE_CLMUL
+
+bool hasCLMUL() {
+    // Needed because we are called during the static initialization
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("pclmul");
+}
+
+bool hasBMI2() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("bmi2");
+}
+
+__attribute__((target("bmi2")))
+void square_64_128_pdep(uint64_t a, uint64_t& high, uint64_t& low) {
+    low = _pdep_u64(a, 0x5555555555555555);
+    high = _pdep_u64(a >> 32, 0x5555555555555555);
+}
+
+__attribute__((target("pclmul,sse2")))
+void square_64_128_clmul(uint64_t a, uint64_t& high, uint64_t& low) {
+    __m128i x = _mm_cvtsi64_si128(a);
+    __m128i res = _mm_clmulepi64_si128(x, x, 0x00);
+    low = _mm_cvtsi128_si64(res);
+    high = _mm_cvtsi128_si64(_mm_unpackhi_epi64(res, res));
+}
+
+__attribute__((target("pclmul,sse2")))
+uint32_t convolution_16_32_clmul(uint16_t a, uint16_t b) {
+    __m128i res = _mm_clmulepi64_si128(_mm_cvtsi32_si128(a), _mm_cvtsi32_si128(b), 0x00);
+    return _mm_cvtsi128_si32(res);
+}
+
+__attribute__((target("pclmul,sse2")))
+uint64_t convolution_32_64_clmul(uint32_t a, uint32_t b) {
+    __m128i res = _mm_clmulepi64_si128(_mm_cvtsi32_si128(a), _mm_cvtsi32_si128(b), 0x00);
+    return _mm_cvtsi128_si64(res);
+}
+
+__attribute__((target("pclmul,sse2")))
+void convolution_64_128_clmul(uint64_t a, uint64_t b, uint64_t& high, uint64_t& low) {
+    __m128i res = _mm_clmulepi64_si128(_mm_cvtsi64_si128(a), _mm_cvtsi64_si128(b), 0x00);
+    low = _mm_cvtsi128_si64(res);
+    high = _mm_cvtsi128_si64(_mm_unpackhi_epi64(res, res));
+}
+
+bool hasAVX2() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+// One instruction per product beats the bitsliced kernels
+__attribute__((target("pclmul,sse2")))
+void convolution_64_128_batch_clmul(const uint64_t* a, const uint64_t* b, unsigned n, uint64_t* high, uint64_t* low) {
+    for (unsigned i = 0; i < n; i++) {
+        convolution_64_128_clmul(a[i], b[i], high[i], low[i]);
+    }
+}
+
+__attribute__((target("avx2")))
+void convolution_64_128_batch_avx2(const uint64_t* a, const uint64_t* b, unsigned n, uint64_t* high, uint64_t* low) {
+    for (unsigned i = 0; i < n; i += 256) {
+        bitslicedBatch<Lanes4, 4>(a + i, b + i, n - i, high + i, low + i);
+    }
+}
+
+bool hasAVX512() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx512f");
+}
+
+// The vectors are loaded before being stored so the shifts can work in
+// place, going down for the left one and up for the right one.
+
+__attribute__((target("avx2")))
+void xor_blocks_avx2(const uint64_t* a, const uint64_t* b, unsigned n, uint64_t* dst) {
+    unsigned i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i*) (a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i*) (b + i));
+        _mm256_storeu_si256((__m256i*) (dst + i), _mm256_xor_si256(x, y));
+    }
+    xor_blocks(a + i, b + i, n - i, dst + i);
+}
+
+__attribute__((target("avx2")))
+void and_blocks_avx2(const uint64_t* a, const uint64_t* b, unsigned n, uint64_t* dst) {
+    unsigned i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i*) (a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i*) (b + i));
+        _mm256_storeu_si256((__m256i*) (dst + i), _mm256_and_si256(x, y));
+    }
+    and_blocks(a + i, b + i, n - i, dst + i);
+}
+
+__attribute__((target("avx2")))
+void or_blocks_avx2(const uint64_t* a, const uint64_t* b, unsigned n, uint64_t* dst) {
+    unsigned i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i*) (a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i*) (b + i));
+        _mm256_storeu_si256((__m256i*) (dst + i), _mm256_or_si256(x, y));
+    }
+    or_blocks(a + i, b + i, n - i, dst + i);
+}
+
+__attribute__((target("avx2")))
+void shift_left_blocks_avx2(const uint64_t* src, unsigned n, unsigned shift, uint64_t* dst) {
+    __m128i left = _mm_cvtsi32_si128(shift);
+    __m128i right = _mm_cvtsi32_si128(64 - shift);
+
+    // The blocks [i - 4, i) also need src[i - 5]
+    unsigned i = n;
+    for (; i >= 5; i -= 4) {
+        __m256i current = _mm256_loadu_si256((const __m256i*) (src + i - 4));
+        __m256i previous = _mm256_loadu_si256((const __m256i*) (src + i - 5));
+        __m256i res = _mm256_or_si256(_mm256_sll_epi64(current, left), _mm256_srl_epi64(previous, right));
+        _mm256_storeu_si256((__m256i*) (dst + i - 4), res);
+    }
+    shiftLeftTail(src, i, shift, dst);
+}
+
+__attribute__((target("avx2")))
+void shift_right_blocks_avx2(const uint64_t* src, unsigned n, unsigned shift, uint64_t* dst) {
+    __m128i right = _mm_cvtsi32_si128(shift);
+    __m128i left = _mm_cvtsi32_si128(64 - shift);
+
+    // The blocks [i, i + 4) also need src[i + 4]
+    unsigned i = 0;
+    for (; i + 4 < n; i += 4) {
+        __m256i current = _mm256_loadu_si256((const __m256i*) (src + i));
+        __m256i next = _mm256_loadu_si256((const __m256i*) (src + i + 1));
+        __m256i res = _mm256_or_si256(_mm256_srl_epi64(current, right), _mm256_sll_epi64(next, left));
+        _mm256_storeu_si256((__m256i*) (dst + i), res);
+    }
+    shiftRightTail(src, i, n, shift, dst);
+}
+
+__attribute__((target("avx512f")))
+void xor_blocks_avx512(const uint64_t* a, const uint64_t* b, unsigned n, uint64_t* dst) {
+    unsigned i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m512i x = _mm512_loadu_si512(a + i);
+        __m512i y = _mm512_loadu_si512(b + i);
+        _mm512_storeu_si512(dst + i, _mm512_xor_si512(x, y));
+    }
+    xor_blocks(a + i, b + i, n - i, dst + i);
+}
+
+__attribute__((target("avx512f")))
+void and_blocks_avx512(const uint64_t* a, const uint64_t* b, unsigned n, uint64_t* dst) {
+    unsigned i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m512i x = _mm512_loadu_si512(a + i);
+        __m512i y = _mm512_loadu_si512(b + i);
+        _mm512_storeu_si512(dst + i, _mm512_and_si512(x, y));
+    }
+    and_blocks(a + i, b + i, n - i, dst + i);
+}
+
+__attribute__((target("avx512f")))
+void or_blocks_avx512(const uint64_t* a, const uint64_t* b, unsigned n, uint64_t* dst) {
+    unsigned i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m512i x = _mm512_loadu_si512(a + i);
+        __m512i y = _mm512_loadu_si512(b + i);
+        _mm512_storeu_si512(dst + i, _mm512_or_si512(x, y));
+    }
+    or_blocks(a + i, b + i, n - i, dst + i);
+}
+
+// The shifts use a vector type as the shift intrinsics of the GCC headers
+// trip maybe-uninitialized warnings. Its loads and stores are unaligned.
+typedef uint64_t UnalignedLanes8 __attribute__((vector_size(64), aligned(8), may_alias));
+
+__attribute__((target("avx512f")))
+void shift_left_blocks_avx512(const uint64_t* src, unsigned n, unsigned shift, uint64_t* dst) {
+    unsigned i = n;
+    for (; i >= 9; i -= 8) {
+        UnalignedLanes8 current = *(const UnalignedLanes8*) (src + i - 8);
+        UnalignedLanes8 previous = *(const UnalignedLanes8*) (src + i - 9);
+        *(UnalignedLanes8*) (dst + i - 8) = (current << shift) | (previous >> (64 - shift));
+    }
+    shiftLeftTail(src, i, shift, dst);
+}
+
+__attribute__((target("avx512f")))
+void shift_right_blocks_avx512(const uint64_t* src, unsigned n, unsigned shift, uint64_t* dst) {
+    unsigned i = 0;
+    for (; i + 8 < n; i += 8) {
+        UnalignedLanes8 current = *(const UnalignedLanes8*) (src + i);
+        UnalignedLanes8 next = *(const UnalignedLanes8*) (src + i + 1);
+        *(UnalignedLanes8*) (dst + i) = (current >> shift) | (next << (64 - shift));
+    }
+    shiftRightTail(src, i, n, shift, dst);
+}
+
+#else
+
+bool hasCLMUL() {
+    return false;
+}
+
+bool hasBMI2() {
+    return false;
+}
+
+void square_64_128_pdep(uint64_t a, uint64_t& high, uint64_t& low) {
+    square_64_128(a, high, low);
+}
+
+void square_64_128_clmul(uint64_t a, uint64_t& high, uint64_t& low) {
+    square_64_128(a, high, low);
+}
+
+uint32_t convolution_16_32_clmul(uint16_t a, uint16_t b) {
+    return convolution_16_32(a, b);
+}
+
+uint64_t convolution_32_64_clmul(uint32_t a, uint32_t b) {
+    return convolution_32_64(a, b);
+}
+
+void convolution_64_128_clmul(uint64_t a, uint64_t b, uint64_t& high, uint64_t& low) {
+    convolution_64_128(a, b, high, low);
+}
+
+bool hasAVX2() {
+    return false;
+}
+
+void convolution_64_128_batch_clmul(const uint64_t* a, const uint64_t* b, unsigned n, uint64_t* high, uint64_t* low) {
+    convolution_64_128_batch(a, b, n, high, low);
+}
+
+void convolution_64_128_batch_avx2(const uint64_t* a, const uint64_t* b, unsigned n, uint64_t* high, uint64_t* low) {
+    convolution_64_128_batch(a, b, n, high, low);
+}
+
+bool hasAVX512() {
+    return false;
+}
+
+void xor_blocks_avx2(const uint64_t* a, const uint64_t* b, unsigned n, uint64_t* dst) {
+    xor_blocks(a, b, n, dst);
+}
+
+void and_blocks_avx2(const uint64_t* a, const uint64_t* b, unsigned n, uint64_t* dst) {
+    and_blocks(a, b, n, dst);
+}
+
+void or_blocks_avx2(const uint64_t* a, const uint64_t* b, unsigned n, uint64_t* dst) {
+    or_blocks(a, b, n, dst);
+}
+
+void shift_left_blocks_avx2(const uint64_t* src, unsigned n, unsigned shift, uint64_t* dst) {
+    shift_left_blocks(src, n, shift, dst);
+}
+
+void shift_right_blocks_avx2(const uint64_t* src, unsigned n, unsigned shift, uint64_t* dst) {
+    shift_right_blocks(src, n, shift, dst);
+}
+
+void xor_blocks_avx512(const uint64_t* a, const uint64_t* b, unsigned n, uint64_t* dst) {
+    xor_blocks(a, b, n, dst);
+}
+
+void and_blocks_avx512(const uint64_t* a, const uint64_t* b, unsigned n, uint64_t* dst) {
+    and_blocks(a, b, n, dst);
+}
+
+void or_blocks_avx512(const uint64_t* a, const uint64_t* b, unsigned n, uint64_t* dst) {
+    or_blocks(a, b, n, dst);
+}
+
+void shift_left_blocks_avx512(const uint64_t* src, unsigned n, unsigned shift, uint64_t* dst) {
+    shift_left_blocks(src, n, shift, dst);
+}
+
+void shift_right_blocks_avx512(const uint64_t* src, unsigned n, unsigned shift, uint64_t* dst) {
+    shift_right_blocks(src, n, shift, dst);
+}
+
+#endif
+
+// The CPU is queried once at startup
+uint32_t (*const fast_convolution_16_32)(uint16_t a, uint16_t b) =
+    hasCLMUL() ? convolution_16_32_clmul : convolution_16_32_comb;
+
+uint64_t (*const fast_convolution_32_64)(uint32_t a, uint32_t b) =
+    hasCLMUL() ? convolution_32_64_clmul : convolution_32_64_comb;
+
+void (*const fast_convolution_64_128)(uint64_t a, uint64_t b, uint64_t& high, uint64_t& low) =
+    hasCLMUL() ? convolution_64_128_clmul : convolution_64_128_comb;
+
+void (*const fast_square_64_128)(uint64_t a, uint64_t& high, uint64_t& low) =
+    hasCLMUL() ? square_64_128_clmul : (hasBMI2() ? square_64_128_pdep : square_64_128);
+
+void (*const fast_convolution_64_128_batch)(const uint64_t* a, const uint64_t* b, unsigned n, uint64_t* high, uint64_t* low) =
+    hasCLMUL() ? convolution_64_128_batch_clmul : (hasAVX2() ? convolution_64_128_batch_avx2 : convolution_64_128_batch);
+
+void (*const fast_xor_blocks)(const uint64_t* a, const uint64_t* b, unsigned n, uint64_t* dst) =
+    hasAVX512() ? xor_blocks_avx512 : (hasAVX2() ? xor_blocks_avx2 : xor_blocks);
+
+void (*const fast_and_blocks)(const uint64_t* a, const uint64_t* b, unsigned n, uint64_t* dst) =
+    hasAVX512() ? and_blocks_avx512 : (hasAVX2() ? and_blocks_avx2 : and_blocks);
+
+void (*const fast_or_blocks)(const uint64_t* a, const uint64_t* b, unsigned n, uint64_t* dst) =
+    hasAVX512() ? or_blocks_avx512 : (hasAVX2() ? or_blocks_avx2 : or_blocks);
+
+void (*const fast_shift_left_blocks)(const uint64_t* src, unsigned n, unsigned shift, uint64_t* dst) =
+    hasAVX512() ? shift_left_blocks_avx512 : (hasAVX2() ? shift_left_blocks_avx2 : shift_left_blocks);
+
+void (*const fast_shift_right_blocks)(const uint64_t* src, unsigned n, unsigned shift, uint64_t* dst) =
+    hasAVX512() ? shift_right_blocks_avx512 : (hasAVX2() ? shift_right_blocks_avx2 : shift_right_blocks);
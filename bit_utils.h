@@ -11,5 +11,95 @@ uint32_t interleave_16_32(uint32_t a, uint32_t b);
 
 uint64_t convolution_32_64(uint32_t a, uint32_t b);
 uint32_t convolution_16_32(uint16_t a, uint16_t b);
+void convolution_64_128(uint64_t a, uint64_t b, uint64_t& high, uint64_t& low);
+
+// Comb kernels, a goes 4 bits at a time through a table of the 16 multiples
+// of b. They replace the bit by bit ones above on the CPUs without CLMUL.
+uint32_t convolution_16_32_comb(uint16_t a, uint16_t b);
+uint64_t convolution_32_64_comb(uint32_t a, uint32_t b);
+void convolution_64_128_comb(uint64_t a, uint64_t b, uint64_t& high, uint64_t& low);
+
+// floor(x^126 / b) for b of degree 63, with it the quotient of w * x^63 by b
+// is the high part of the carry-less product of w by the reciprocal.
+uint64_t reciprocal_64(uint64_t b);
+
+// Inverse of f modulo x^64, f must have its constant coefficient set
+uint64_t series_inverse_64(uint64_t f);
+
+// Reverses the order of the 64 bits of v
+uint64_t reverse_64(uint64_t v);
+
+// Transposes the 64x64 bit matrix m, bit j of m[i] goes to bit i of m[j]
+void transpose_64x64(uint64_t m[64]);
+
+// high[i], low[i] = a[i] * b[i] for i < n. The products are bitsliced: 64
+// operands are transposed so that word k holds bit k of each of them, then
+// they are all multiplied at once by Karatsuba on these words with AND and
+// XOR, and the result transposed back. The AVX2 kernel does 256 at a time.
+// With CLMUL a loop of single products is still faster, the bitsliced
+// kernels are for the CPUs without it.
+void convolution_64_128_batch(const uint64_t* a, const uint64_t* b, unsigned n, uint64_t* high, uint64_t* low);
+void convolution_64_128_batch_avx2(const uint64_t* a, const uint64_t* b, unsigned n, uint64_t* high, uint64_t* low);
+void convolution_64_128_batch_clmul(const uint64_t* a, const uint64_t* b, unsigned n, uint64_t* high, uint64_t* low);
+bool hasAVX2();
+
+// Carry-less multiply instruction (PCLMULQDQ) kernels, they must only be
+// called when hasCLMUL() is true.
+bool hasCLMUL();
+uint32_t convolution_16_32_clmul(uint16_t a, uint16_t b);
+uint64_t convolution_32_64_clmul(uint32_t a, uint32_t b);
+void convolution_64_128_clmul(uint64_t a, uint64_t b, uint64_t& high, uint64_t& low);
+
+// Squaring over GF(2) spreads the bits apart: bit i of a goes to bit 2i.
+// The portable kernel uses a table of the spread bytes, the hardware ones a
+// parallel bits deposit (PDEP, BMI2) or a carry-less multiply of a by itself.
+void square_64_128(uint64_t a, uint64_t& high, uint64_t& low);
+// The reverse of the spreading, gathers the bits at the even positions
+uint32_t even_bits_64_32(uint64_t v);
+bool hasBMI2();
+void square_64_128_pdep(uint64_t a, uint64_t& high, uint64_t& low);
+void square_64_128_clmul(uint64_t a, uint64_t& high, uint64_t& low);
+
+// Kernels on the block arrays of the big polys. The portable ones go a block
+// at a time, the AVX2 and AVX-512 ones 4 and 8 blocks at a time and must
+// only be called when hasAVX2() and hasAVX512() are true.
+// dst[i] = a[i] op b[i] for i < n, dst can be a or b.
+void xor_blocks(const uint64_t* a, const uint64_t* b, unsigned n, uint64_t* dst);
+void and_blocks(const uint64_t* a, const uint64_t* b, unsigned n, uint64_t* dst);
+void or_blocks(const uint64_t* a, const uint64_t* b, unsigned n, uint64_t* dst);
+// dst[i] = (src[i] << shift) | (src[i - 1] >> (64 - shift)) for i < n with
+// src[-1] read as 0 and 0 < shift < 64. It goes from the top block down so
+// dst can be src or above it.
+void shift_left_blocks(const uint64_t* src, unsigned n, unsigned shift, uint64_t* dst);
+// dst[i] = (src[i] >> shift) | (src[i + 1] << (64 - shift)) for i < n with
+// src[n] read as 0 and 0 < shift < 64. It goes from the bottom block up so
+// dst can be src or below it.
+void shift_right_blocks(const uint64_t* src, unsigned n, unsigned shift, uint64_t* dst);
+bool hasAVX512();
+void xor_blocks_avx2(const uint64_t* a, const uint64_t* b, unsigned n, uint64_t* dst);
+void and_blocks_avx2(const uint64_t* a, const uint64_t* b, unsigned n, uint64_t* dst);
+void or_blocks_avx2(const uint64_t* a, const uint64_t* b, unsigned n, uint64_t* dst);
+void shift_left_blocks_avx2(const uint64_t* src, unsigned n, unsigned shift, uint64_t* dst);
+void shift_right_blocks_avx2(const uint64_t* src, unsigned n, unsigned shift, uint64_t* dst);
+void xor_blocks_avx512(const uint64_t* a, const uint64_t* b, unsigned n, uint64_t* dst);
+void and_blocks_avx512(const uint64_t* a, const uint64_t* b, unsigned n, uint64_t* dst);
+void or_blocks_avx512(const uint64_t* a, const uint64_t* b, unsigned n, uint64_t* dst);
+void shift_left_blocks_avx512(const uint64_t* src, unsigned n, unsigned shift, uint64_t* dst);
+void shift_right_blocks_avx512(const uint64_t* src, unsigned n, unsigned shift, uint64_t* dst);
+
+// Leaf kernels used by the multiplications, they point to the CLMUL kernels
+// when the CPU supports them and to the comb ones otherwise.
+extern uint32_t (*const fast_convolution_16_32)(uint16_t a, uint16_t b);
+extern uint64_t (*const fast_convolution_32_64)(uint32_t a, uint32_t b);
+extern void (*const fast_convolution_64_128)(uint64_t a, uint64_t b, uint64_t& high, uint64_t& low);
+extern void (*const fast_square_64_128)(uint64_t a, uint64_t& high, uint64_t& low);
+extern void (*const fast_convolution_64_128_batch)(const uint64_t* a, const uint64_t* b, unsigned n, uint64_t* high, uint64_t* low);
+
+// The widest of the block array kernels the CPU supports
+extern void (*const fast_xor_blocks)(const uint64_t* a, const uint64_t* b, unsigned n, uint64_t* dst);
+extern void (*const fast_and_blocks)(const uint64_t* a, const uint64_t* b, unsigned n, uint64_t* dst);
+extern void (*const fast_or_blocks)(const uint64_t* a, const uint64_t* b, unsigned n, uint64_t* dst);
+extern void (*const fast_shift_left_blocks)(const uint64_t* src, unsigned n, unsigned shift, uint64_t* dst);
+extern void (*const fast_shift_right_blocks)(const uint64_t* src, unsigned n, unsigned shift, uint64_t* dst);
 
 #endif //BIT_UTILS_H
@@ -0,0 +1,450 @@
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <climits>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "poly.h"
+#include "poly_corpus.h"
+#include "poly_factor.h"
+#include "poly_irreducible.h"
+#include "poly_modulus.h"
+#include "thread_pool.h"
+
+// Command line processing of polys read from stdin or files. The polys go
+// through three pipelined stages connected by bounded queues: a thread
+// parses them into batches, a pool of workers applies the operation to the
+// batches and the main thread formats the results in the order of the input
+// and writes them. The parser takes a ticket for each batch and the writer
+// gives it back once the batch is written, so a slow batch can't make the
+// ones after it pile up waiting for their turn.
+//
+//   poly_cli mul|mod|gcd|factor|irreducible [--operand hex]
+//            [--input-format hex|binary] [--output-format hex|binary]
+//            [--output path] [--threads n] [--batch n] [files...]
+//
+// mul, mod and gcd take the fixed operand, or modulus, with --operand. Hex
+// polys are one per line, most significant digit first with an optional 0x,
+// bit i of the number being the coefficient of x^i. The lines that don't
+// parse are reported on stderr and give an empty line, or a 0 poly in binary
+// output so that the records stay aligned. Binary inputs are corpus files,
+// see poly_corpus.h, which are mapped. Binary output is a corpus written to
+// --output, only for mul, mod and gcd. factor prints the factors as
+// hex^multiplicity separated by spaces and irreducible prints 1 or 0.
+
+enum class Operation {
+    MUL,
+    MOD,
+    GCD,
+    FACTOR,
+    IRREDUCIBLE,
+};
+
+struct Options {
+    Operation operation;
+    std::string operand;
+    bool binaryInput = false;
+    bool binaryOutput = false;
+    std::string output;
+    unsigned threads = 0;
+    unsigned batchSize = 256;
+    std::vector<std::string> inputs;
+};
+
+// The unit of work going through the stages, results are filled in by the
+// workers depending on the operation
+struct Batch {
+    uint64_t sequence;
+    std::vector<Poly> polys;
+    std::vector<char> invalid;
+    std::vector<Poly> results;
+    std::vector<std::vector<PolyFactor>> factors;
+    std::vector<char> irreducible;
+};
+
+/*****************************************************************************\
+|*                                    Hex                                    *|
+\*****************************************************************************/
+
+// Trims the whitespace around the poly
+static bool parseHex(const std::string& line, Poly& p) {
+    unsigned start = 0;
+    unsigned end = line.size();
+    while (start < end and std::isspace((unsigned char) line[start])) {
+        start ++;
+    }
+    while (end > start and std::isspace((unsigned char) line[end - 1])) {
+        end --;
+    }
+    return Poly::fromHex(line.data() + start, line.data() + end, p);
+}
+
+static void appendHex(const Poly& p, std::string& out) {
+    unsigned size = out.size();
+    out.resize(size + p.hexSize());
+    p.toHex(&out[size]);
+}
+
+/*****************************************************************************\
+|*                                   Stages                                  *|
+\*****************************************************************************/
+
+// Reads all the inputs in batches, the errors are reported and counted
+static void parseStage(const Options& options, BoundedQueue<Batch>& parsed, BoundedQueue<bool>& tickets,
+        std::atomic<unsigned>& errors) {
+    Batch batch;
+    uint64_t sequence = 0;
+
+    auto add = [&](const Poly& p, bool invalid) {
+        batch.polys.push_back(p);
+        batch.invalid.push_back(invalid);
+        if (batch.polys.size() == options.batchSize) {
+            batch.sequence = sequence++;
+            tickets.push(true);
+            parsed.push(std::move(batch));
+            batch = Batch();
+        }
+    };
+
+    std::vector<std::string> inputs = options.inputs;
+    if (inputs.empty()) {
+        inputs.push_back("-");
+    }
+
+    for (const std::string& input : inputs) {
+        if (options.binaryInput) {
+            PolyCorpusReader reader;
+            if (not reader.open(input)) {
+                std::cerr << input << ": not a poly corpus" << std::endl;
+                errors ++;
+                continue;
+            }
+            for (const Poly& p : reader) {
+                add(p, false);
+            }
+            continue;
+        }
+
+        std::ifstream file;
+        if (input != "-") {
+            file.open(input);
+            if (not file) {
+                std::cerr << input << ": can't be opened" << std::endl;
+                errors ++;
+                continue;
+            }
+        }
+        std::istream& in = input == "-" ? std::cin : file;
+
+        std::string line;
+        Poly p;
+        for (uint64_t lineNumber = 1; std::getline(in, line); lineNumber++) {
+            bool valid = parseHex(line, p);
+            if (not valid) {
+                std::cerr << input << ":" << lineNumber << ": not a hex poly" << std::endl;
+                errors ++;
+                p = Poly();
+            }
+            add(p, not valid);
+        }
+    }
+
+    if (not batch.polys.empty()) {
+        batch.sequence = sequence;
+        tickets.push(true);
+        parsed.push(std::move(batch));
+    }
+    parsed.close();
+}
+
+static void compute(Operation operation, const Poly& operand, const PolyModulus* modulus, Batch& batch) {
+    unsigned n = batch.polys.size();
+    switch (operation) {
+        case Operation::MUL:
+            batch.results.resize(n);
+            for (unsigned i = 0; i < n; i++) {
+                batch.polys[i].multiply(operand, batch.results[i]);
+            }
+            break;
+
+        case Operation::MOD:
+            batch.results = batch.polys;
+            for (Poly& result : batch.results) {
+                modulus->reduce(result);
+            }
+            break;
+
+        case Operation::GCD:
+            batch.results.resize(n);
+            for (unsigned i = 0; i < n; i++) {
+                batch.results[i] = batch.polys[i].gcd(operand);
+            }
+            break;
+
+        case Operation::FACTOR:
+            batch.factors.resize(n);
+            for (unsigned i = 0; i < n; i++) {
+                if (batch.polys[i].size() != 0) {
+                    batch.factors[i] = factor(batch.polys[i]);
+                }
+            }
+            break;
+
+        case Operation::IRREDUCIBLE:
+            batch.irreducible.resize(n);
+            for (unsigned i = 0; i < n; i++) {
+                batch.irreducible[i] = isIrreducible(batch.polys[i]);
+            }
+            break;
+    }
+}
+
+static void formatBatch(Operation operation, const Batch& batch, std::string& out) {
+    for (unsigned i = 0; i < batch.polys.size(); i++) {
+        if (batch.invalid[i]) {
+            out += '\n';
+            continue;
+        }
+
+        switch (operation) {
+            case Operation::MUL:
+            case Operation::MOD:
+            case Operation::GCD:
+                appendHex(batch.results[i], out);
+                break;
+
+            case Operation::FACTOR:
+                // 0 and 1 have no factors, they are printed as they are
+                if (batch.factors[i].empty()) {
+                    appendHex(batch.polys[i], out);
+                }
+                for (unsigned j = 0; j < batch.factors[i].size(); j++) {
+                    const PolyFactor& factor = batch.factors[i][j];
+                    out += j == 0 ? "" : " ";
+                    appendHex(factor.poly, out);
+                    if (factor.multiplicity != 1) {
+                        out += "^" + std::to_string(factor.multiplicity);
+                    }
+                }
+                break;
+
+            case Operation::IRREDUCIBLE:
+                out += batch.irreducible[i] ? '1' : '0';
+                break;
+        }
+        out += '\n';
+    }
+}
+
+/*****************************************************************************\
+|*                                    Main                                   *|
+\*****************************************************************************/
+
+static void printUsage() {
+    std::cerr << "Usage: poly_cli mul|mod|gcd|factor|irreducible [--operand hex]" << std::endl
+        << "                [--input-format hex|binary] [--output-format hex|binary]" << std::endl
+        << "                [--output path] [--threads n] [--batch n] [files...]" << std::endl;
+}
+
+// A positive count, without anything after it
+static bool parseCount(const std::string& value, unsigned& count) {
+    size_t end = 0;
+    unsigned long parsed = 0;
+    try {
+        parsed = std::stoul(value, &end);
+    } catch (const std::exception&) {
+        return false;
+    }
+    if (end != value.size() or parsed == 0 or parsed > UINT_MAX) {
+        return false;
+    }
+    count = parsed;
+    return true;
+}
+
+static bool parseOptions(int argc, char** argv, Options& options) {
+    if (argc < 2) {
+        return false;
+    }
+
+    std::string operation = argv[1];
+    if (operation == "mul") {
+        options.operation = Operation::MUL;
+    } else if (operation == "mod") {
+        options.operation = Operation::MOD;
+    } else if (operation == "gcd") {
+        options.operation = Operation::GCD;
+    } else if (operation == "factor") {
+        options.operation = Operation::FACTOR;
+    } else if (operation == "irreducible") {
+        options.operation = Operation::IRREDUCIBLE;
+    } else {
+        std::cerr << "Unknown operation " << operation << std::endl;
+        return false;
+    }
+
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.compare(0, 2, "--") != 0) {
+            options.inputs.push_back(arg);
+            continue;
+        }
+        if (i + 1 == argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return false;
+        }
+        std::string value = argv[++i];
+
+        if (arg == "--operand") {
+            options.operand = value;
+        } else if (arg == "--input-format" and (value == "hex" or value == "binary")) {
+            options.binaryInput = value == "binary";
+        } else if (arg == "--output-format" and (value == "hex" or value == "binary")) {
+            options.binaryOutput = value == "binary";
+        } else if (arg == "--output") {
+            options.output = value;
+        } else if (arg == "--threads" or arg == "--batch") {
+            if (not parseCount(value, arg == "--threads" ? options.threads : options.batchSize)) {
+                std::cerr << arg << " takes a positive number, not " << value << std::endl;
+                return false;
+            }
+        } else {
+            std::cerr << "Unknown option " << arg << " " << value << std::endl;
+            return false;
+        }
+    }
+
+    bool takesOperand = options.operation == Operation::MUL or options.operation == Operation::MOD or
+        options.operation == Operation::GCD;
+    if (takesOperand and options.operand.empty()) {
+        std::cerr << operation << " needs an --operand" << std::endl;
+        return false;
+    }
+    if (options.binaryOutput and (not takesOperand or options.output.empty())) {
+        std::cerr << "Binary output is for mul, mod and gcd and needs an --output" << std::endl;
+        return false;
+    }
+    bool readsStdin = options.inputs.empty() or
+        std::find(options.inputs.begin(), options.inputs.end(), "-") != options.inputs.end();
+    if (options.binaryInput and readsStdin) {
+        std::cerr << "Binary inputs must be files, they are mapped" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    std::ios::sync_with_stdio(false);
+    // Else every read of the parser flushes cout under the writer
+    std::cin.tie(nullptr);
+
+    Options options;
+    if (not parseOptions(argc, argv, options)) {
+        printUsage();
+        return 1;
+    }
+
+    Poly operand;
+    if (not options.operand.empty() and not parseHex(options.operand, operand)) {
+        std::cerr << "The operand " << options.operand << " is not a hex poly" << std::endl;
+        return 1;
+    }
+    if (options.operation == Operation::MOD and operand.size() == 0) {
+        std::cerr << "The modulus must not be 0" << std::endl;
+        return 1;
+    }
+    std::unique_ptr<PolyModulus> modulus;
+    if (options.operation == Operation::MOD) {
+        modulus.reset(new PolyModulus(operand));
+    }
+
+    std::ofstream outputFile;
+    PolyCorpusWriter corpus;
+    if (options.binaryOutput) {
+        if (not corpus.open(options.output)) {
+            std::cerr << options.output << ": can't be written" << std::endl;
+            return 1;
+        }
+    } else if (not options.output.empty()) {
+        outputFile.open(options.output);
+        if (not outputFile) {
+            std::cerr << options.output << ": can't be written" << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& out = options.output.empty() ? std::cout : outputFile;
+
+    unsigned nWorkers = options.threads != 0 ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+    BoundedQueue<Batch> parsed(2 * nWorkers);
+    BoundedQueue<Batch> computed(2 * nWorkers);
+    // Batches parsed and not yet written, at most as many as the queues hold
+    BoundedQueue<bool> tickets(4 * nWorkers);
+    std::atomic<unsigned> errors(0);
+
+    std::thread parser(parseStage, std::cref(options), std::ref(parsed), std::ref(tickets), std::ref(errors));
+
+    // The last worker to finish closes the queue of the formatting stage
+    std::atomic<unsigned> running(nWorkers);
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; i < nWorkers; i++) {
+        workers.emplace_back([&]() {
+            Batch batch;
+            while (parsed.pop(batch)) {
+                compute(options.operation, operand, modulus.get(), batch);
+                computed.push(std::move(batch));
+            }
+            if (running.fetch_sub(1) == 1) {
+                computed.close();
+            }
+        });
+    }
+
+    // The batches come out of the workers in any order, they wait in pending
+    // until the ones before them are written. Once a write fails the batches
+    // are still taken so that the other stages can finish.
+    std::map<uint64_t, Batch> pending;
+    uint64_t nextSequence = 0;
+    bool written = true;
+    std::string text;
+    Batch batch;
+    while (computed.pop(batch)) {
+        pending.emplace(batch.sequence, std::move(batch));
+
+        for (auto it = pending.find(nextSequence); it != pending.end(); it = pending.find(nextSequence)) {
+            const Batch& done = it->second;
+            bool wasWritten = written;
+            if (written and options.binaryOutput) {
+                for (unsigned i = 0; i < done.results.size() and written; i++) {
+                    written = corpus.write(done.invalid[i] ? Poly() : done.results[i]);
+                }
+            } else if (written) {
+                text.clear();
+                formatBatch(options.operation, done, text);
+                written = bool(out.write(text.data(), text.size()));
+            }
+            if (wasWritten and not written) {
+                std::cerr << (options.output.empty() ? "stdout" : options.output) << ": write failed" << std::endl;
+            }
+            pending.erase(it);
+            nextSequence ++;
+
+            bool ticket;
+            tickets.pop(ticket);
+        }
+    }
+
+    parser.join();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    written = (options.binaryOutput ? corpus.close() : bool(out.flush())) and written;
+    return errors.load() == 0 and written ? 0 : 1;
+}
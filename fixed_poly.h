@@ -0,0 +1,269 @@
+#ifndef FIXED_POLY_H
+#define FIXED_POLY_H
+
+#include <iostream>
+
+#include "bit_utils.h"
+#include "poly.h"
+
+// Polynomial with at most Bits coefficients, everything is sized at compile
+// time so that the loops and the Karatsuba recursion can be fully unrolled.
+// Products are returned in a FixedPoly twice as wide, shifts and the
+// conversion from Poly drop the coefficients that go past Bits.
+template<unsigned Bits>
+class FixedPoly {
+    static_assert(Bits > 0 and Bits % Poly::BLOCK_SIZE == 0, "FixedPoly must have a whole number of blocks");
+
+    public:
+        typedef Poly::Block Block;
+        typedef Poly::Bit Bit;
+        static constexpr unsigned BLOCK_SIZE = Poly::BLOCK_SIZE;
+        static constexpr unsigned NUM_BLOCKS = Bits / BLOCK_SIZE;
+        static constexpr int MAX_DEGREE = Bits - 1;
+
+        FixedPoly();
+        explicit FixedPoly(const Poly& p);
+
+        static FixedPoly fromInt(Block value);
+
+        Poly toPoly() const;
+
+        Bit bit(unsigned i) const;
+        Block block(unsigned i) const;
+        int degree() const;
+        unsigned size() const;
+
+        FixedPoly operator+(const FixedPoly& other) const;
+        FixedPoly operator-(const FixedPoly& other) const;
+        FixedPoly<2 * Bits> operator*(const FixedPoly& other) const;
+        FixedPoly operator&(const FixedPoly& other) const;
+        FixedPoly operator|(const FixedPoly& other) const;
+        FixedPoly operator^(const FixedPoly& other) const;
+        FixedPoly operator<<(int i) const;
+        FixedPoly operator>>(int i) const;
+
+        FixedPoly& operator+=(const FixedPoly& other);
+
+        void setBit(unsigned i, Bit value);
+        void setBlock(unsigned i, Block value);
+
+        Block blocks[NUM_BLOCKS];
+};
+
+template<unsigned Bits>
+std::ostream& operator<<(std::ostream& os, const FixedPoly<Bits>& p);
+
+// Karatsuba on NBlocks blocks, res must have 2 * NBlocks blocks. The split
+// depth is known at compile time so the whole recursion gets inlined.
+template<unsigned NBlocks>
+struct FixedKaratsuba {
+    typedef Poly::Block Block;
+    static constexpr unsigned CUT = (NBlocks + 1) / 2;
+    static constexpr unsigned DEPTH = 1 + FixedKaratsuba<CUT>::DEPTH;
+
+    static void multiply(const Block* a, const Block* b, Block* res);
+};
+
+template<>
+struct FixedKaratsuba<1> {
+    typedef Poly::Block Block;
+    static constexpr unsigned DEPTH = 0;
+
+    static void multiply(const Block* a, const Block* b, Block* res) {
+        fast_convolution_64_128(a[0], b[0], res[1], res[0]);
+    }
+};
+
+// Templates definitions
+
+template<unsigned Bits>
+FixedPoly<Bits>::FixedPoly() {
+    for (unsigned i = 0; i < NUM_BLOCKS; i++) {
+        this->blocks[i] = 0;
+    }
+}
+
+template<unsigned Bits>
+FixedPoly<Bits>::FixedPoly(const Poly& p) {
+    for (unsigned i = 0; i < NUM_BLOCKS; i++) {
+        this->blocks[i] = p.block(i);
+    }
+}
+
+template<unsigned Bits>
+FixedPoly<Bits> FixedPoly<Bits>::fromInt(Block value) {
+    FixedPoly res;
+    res.blocks[0] = value;
+    return res;
+}
+
+template<unsigned Bits>
+Poly FixedPoly<Bits>::toPoly() const {
+    Poly res(NUM_BLOCKS);
+    for (unsigned i = 0; i < NUM_BLOCKS; i++) {
+        res.setBlock(i, this->blocks[i]);
+    }
+    res.computeDegree();
+    return res;
+}
+
+template<unsigned Bits>
+typename FixedPoly<Bits>::Bit FixedPoly<Bits>::bit(unsigned i) const {
+    return (this->block(i / BLOCK_SIZE) >> (i % BLOCK_SIZE)) & 1;
+}
+
+template<unsigned Bits>
+typename FixedPoly<Bits>::Block FixedPoly<Bits>::block(unsigned i) const {
+    if (i >= NUM_BLOCKS) {
+        return 0;
+    }
+    return this->blocks[i];
+}
+
+template<unsigned Bits>
+int FixedPoly<Bits>::degree() const {
+    for (unsigned i = NUM_BLOCKS; i-->0;) {
+        if (this->blocks[i] != 0) {
+            return i * BLOCK_SIZE + log2_u64(this->blocks[i]);
+        }
+    }
+    return -1;
+}
+
+template<unsigned Bits>
+unsigned FixedPoly<Bits>::size() const {
+    return this->degree() + 1;
+}
+
+template<unsigned Bits>
+FixedPoly<Bits> FixedPoly<Bits>::operator+(const FixedPoly& other) const {
+    FixedPoly res;
+    for (unsigned i = 0; i < NUM_BLOCKS; i++) {
+        res.blocks[i] = this->blocks[i] ^ other.blocks[i];
+    }
+    return res;
+}
+
+template<unsigned Bits>
+FixedPoly<Bits> FixedPoly<Bits>::operator-(const FixedPoly& other) const {
+    return *this + other;
+}
+
+template<unsigned Bits>
+FixedPoly<2 * Bits> FixedPoly<Bits>::operator*(const FixedPoly& other) const {
+    FixedPoly<2 * Bits> res;
+    FixedKaratsuba<NUM_BLOCKS>::multiply(this->blocks, other.blocks, res.blocks);
+    return res;
+}
+
+template<unsigned Bits>
+FixedPoly<Bits> FixedPoly<Bits>::operator&(const FixedPoly& other) const {
+    FixedPoly res;
+    for (unsigned i = 0; i < NUM_BLOCKS; i++) {
+        res.blocks[i] = this->blocks[i] & other.blocks[i];
+    }
+    return res;
+}
+
+template<unsigned Bits>
+FixedPoly<Bits> FixedPoly<Bits>::operator|(const FixedPoly& other) const {
+    FixedPoly res;
+    for (unsigned i = 0; i < NUM_BLOCKS; i++) {
+        res.blocks[i] = this->blocks[i] | other.blocks[i];
+    }
+    return res;
+}
+
+template<unsigned Bits>
+FixedPoly<Bits> FixedPoly<Bits>::operator^(const FixedPoly& other) const {
+    return *this + other;
+}
+
+template<unsigned Bits>
+FixedPoly<Bits> FixedPoly<Bits>::operator<<(int i) const {
+    FixedPoly res;
+    int blockShift = i / BLOCK_SIZE;
+    int iMod = i % BLOCK_SIZE;
+
+    // Same as Poly::shiftLeft, with the high part of the previous block
+    // only gathered when the shift isn't a multiple of the block size
+    for (int j = blockShift; j < (int) NUM_BLOCKS; j++) {
+        res.blocks[j] = this->blocks[j - blockShift] << iMod;
+        if (iMod != 0 and j > blockShift) {
+            res.blocks[j] |= this->blocks[j - blockShift - 1] >> (BLOCK_SIZE - iMod);
+        }
+    }
+    return res;
+}
+
+template<unsigned Bits>
+FixedPoly<Bits> FixedPoly<Bits>::operator>>(int i) const {
+    FixedPoly res;
+    int blockShift = i / BLOCK_SIZE;
+    int iMod = i % BLOCK_SIZE;
+
+    for (int j = 0; j + blockShift < (int) NUM_BLOCKS; j++) {
+        res.blocks[j] = this->blocks[j + blockShift] >> iMod;
+        if (iMod != 0 and j + blockShift + 1 < (int) NUM_BLOCKS) {
+            res.blocks[j] |= this->blocks[j + blockShift + 1] << (BLOCK_SIZE - iMod);
+        }
+    }
+    return res;
+}
+
+template<unsigned Bits>
+FixedPoly<Bits>& FixedPoly<Bits>::operator+=(const FixedPoly& other) {
+    for (unsigned i = 0; i < NUM_BLOCKS; i++) {
+        this->blocks[i] ^= other.blocks[i];
+    }
+    return *this;
+}
+
+template<unsigned Bits>
+void FixedPoly<Bits>::setBit(unsigned i, Bit value) {
+    Block valueBlock = value;
+
+    this->blocks[i / BLOCK_SIZE] &= ~(((Block)1) << (i % BLOCK_SIZE));
+    this->blocks[i / BLOCK_SIZE] |= (valueBlock << (i % BLOCK_SIZE));
+}
+
+template<unsigned Bits>
+void FixedPoly<Bits>::setBlock(unsigned i, Block value) {
+    this->blocks[i] = value;
+}
+
+template<unsigned NBlocks>
+void FixedKaratsuba<NBlocks>::multiply(const Block* a, const Block* b, Block* res) {
+    static constexpr unsigned HIGH = NBlocks - CUT;
+
+    // c0 and c2 are computed directly in the low and high halves of res
+    Block* c0 = res;
+    Block* c2 = res + 2 * CUT;
+    FixedKaratsuba<CUT>::multiply(a, b, c0);
+    FixedKaratsuba<HIGH>::multiply(a + CUT, b + CUT, c2);
+
+    Block aSum[CUT];
+    Block bSum[CUT];
+    for (unsigned i = 0; i < CUT; i++) {
+        aSum[i] = a[i] ^ (i < HIGH ? a[CUT + i] : 0);
+        bSum[i] = b[i] ^ (i < HIGH ? b[CUT + i] : 0);
+    }
+
+    Block c1[2 * CUT];
+    FixedKaratsuba<CUT>::multiply(aSum, bSum, c1);
+
+    for (unsigned i = 0; i < 2 * CUT; i++) {
+        c1[i] ^= c0[i] ^ (i < 2 * HIGH ? c2[i] : 0);
+    }
+
+    for (unsigned i = 0; i < 2 * CUT; i++) {
+        res[CUT + i] ^= c1[i];
+    }
+}
+
+template<unsigned Bits>
+std::ostream& operator<<(std::ostream& os, const FixedPoly<Bits>& p) {
+    return os << p.toPoly();
+}
+
+#endif //FIXED_POLY_H
@@ -1,8 +1,24 @@
+#include <atomic>
 #include <chrono>
+#include <cctype>
+#include <climits>
+#include <cstdio>
+#include <cstring>
 #include <random>
+#include <stdexcept>
 #include <vector>
+#include "bit_utils.h"
+#include "fixed_poly.h"
 #include "poly.h"
+#include "poly_corpus.h"
+#include "poly_factor.h"
+#include "poly_irreducible.h"
+#include "poly_modulus.h"
+#include "poly_sparse.h"
+#include "poly_stats.h"
+#include "thread_pool.h"
 #include "utils.h"
+#include "workspace.h"
 
 
 void bench_multiply() {
@@ -22,8 +38,8 @@ void bench_multiply() {
         int tries = 0;
         int successes = 0;
 
-        for (Poly p : polys) {
-            for (Poly q : polys) {
+        for (const Poly& p : polys) {
+            for (const Poly& q : polys) {
                 if (p.degree() + q.degree() >= 256) {
                     continue;
                 }
@@ -46,8 +62,8 @@ void bench_multiply() {
         int forceBench = 0;
 
         auto start = std::chrono::high_resolution_clock::now();
-        for (Poly p : polys) {
-            for (Poly q : polys) {
+        for (const Poly& p : polys) {
+            for (const Poly& q : polys) {
                 if (p.degree() + q.degree() >= 256) {
                     continue;
                 }
@@ -68,8 +84,8 @@ void bench_multiply() {
         int forceBench = 0;
 
         auto start = std::chrono::high_resolution_clock::now();
-        for (Poly p : polys) {
-            for (Poly q : polys) {
+        for (const Poly& p : polys) {
+            for (const Poly& q : polys) {
                 if (p.degree() + q.degree() >= 256) {
                     continue;
                 }
@@ -84,10 +100,55 @@ void bench_multiply() {
 
         std::cout << "Karatsuba32 took " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms" << std::endl;
     }
+
+    // 4 - Check and bench the batch multiplication on all the pairs of polys
+    // of degree < 64, plus a few bigger ones that take the general path
+    {
+        std::vector<Poly> left, right;
+        for (const Poly& p : polys) {
+            for (const Poly& q : polys) {
+                if (p.degree() < 64 and q.degree() < 64) {
+                    left.push_back(p);
+                    right.push_back(q);
+                }
+            }
+        }
+        for (unsigned i = 0; i < 10; i++) {
+            left.push_back(Poly::random(64 + 10 * i, generator));
+            right.push_back(polys[i % polys.size()]);
+        }
+
+        std::vector<Poly> expected(left.size());
+        auto start = std::chrono::high_resolution_clock::now();
+        for (unsigned i = 0; i < left.size(); i++) {
+            left[i].multiply(right[i], expected[i]);
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+
+        std::cout << "One by one degree < 64 took " << std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << " us" << std::endl;
+
+        std::vector<Poly> res(left.size());
+        start = std::chrono::high_resolution_clock::now();
+        Poly::multiplyBatch(left, right, res);
+        end = std::chrono::high_resolution_clock::now();
+
+        std::cout << "Batch degree < 64 took " << std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << " us" << std::endl;
+
+        int tries = 0;
+        int successes = 0;
+        for (unsigned i = 0; i < left.size(); i++) {
+            tries ++;
+            if ((res[i] + expected[i]).size() == 0 and res[i].degree() == expected[i].degree()) {
+                successes ++;
+            }
+        }
+
+        std::cout << "Batch multiply success ratio : (" << successes << "/" << tries << ")" << std::endl;
+    }
 }
 
 Poly naiveShiftLeft(const Poly& p, int i) {
-    Poly res(p.size() + i);
+    Poly res((p.size() + i) / Poly::BLOCK_SIZE + 1);
     for (unsigned j = 0; j < p.size(); j++) {
         res.setBit(i + j, p.bit(j));
     }
@@ -96,7 +157,7 @@ Poly naiveShiftLeft(const Poly& p, int i) {
 }
 
 Poly naiveShiftRight(const Poly& p, int i) {
-    Poly res(p.size() - i);
+    Poly res((p.size() - i) / Poly::BLOCK_SIZE + 1);
     for (unsigned j = i; j < p.size(); j++) {
         res.setBit(j - i, p.bit(j));
     }
@@ -121,14 +182,16 @@ void bench_shifts() {
         int tries = 0;
         int successes = 0;
 
-        for (Poly p : polys) {
+        for (const Poly& p : polys) {
             for (unsigned i = 0; i < 256 - p.size(); i++) {
                 tries ++;
 
                 Poly res1 = naiveShiftLeft(p, i);
                 Poly res2 = p << i;
+                Poly res3 = p;
+                res3 <<= i;
 
-                if ((res1 + res2).size() == 0) {
+                if ((res1 + res2).size() == 0 and (res1 + res3).size() == 0) {
                     successes ++;
                 }
             }
@@ -138,8 +201,10 @@ void bench_shifts() {
 
                 Poly res1 = naiveShiftRight(p, i);
                 Poly res2 = p >> i;
+                Poly res3 = p;
+                res3 >>= i;
 
-                if ((res1 + res2).size() == 0) {
+                if ((res1 + res2).size() == 0 and (res1 + res3).size() == 0) {
                     successes ++;
                 }
             }
@@ -153,7 +218,7 @@ void bench_shifts() {
         int forceBench = 0;
 
         auto start = std::chrono::high_resolution_clock::now();
-        for (Poly p : polys) {
+        for (const Poly& p : polys) {
             for (unsigned i = 0; i < 256 - p.size(); i++) {
                 Poly r = naiveShiftLeft(p, i);
                 forceBench += r.degree();
@@ -177,7 +242,7 @@ void bench_shifts() {
         int forceBench = 0;
 
         auto start = std::chrono::high_resolution_clock::now();
-        for (Poly p : polys) {
+        for (const Poly& p : polys) {
             for (unsigned i = 0; i < 256 - p.size(); i++) {
                 Poly r = p << i;
                 forceBench += r.degree();
@@ -195,6 +260,232 @@ void bench_shifts() {
 
         std::cout << "Naive took " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms" << std::endl;
     }
+
+    // 4 - Bench the destination parameter method
+    {
+        int forceBench = 0;
+        Poly r;
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (const Poly& p : polys) {
+            for (unsigned i = 0; i < 256 - p.size(); i++) {
+                p.shiftLeft(i, r);
+                forceBench += r.degree();
+            }
+
+            for (unsigned i = 0;  i <= p.size(); i++) {
+                p.shiftRight(i, r);
+                forceBench += r.degree();
+            }
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+
+        volatile int forceBench2 = forceBench;
+        (void) forceBench2;
+
+        std::cout << "Destination parameter took " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms" << std::endl;
+    }
+
+    // 5 - Check the fused shifted add against the shift then add
+    {
+        int tries = 0;
+        int successes = 0;
+
+        for (unsigned k = 0; k + 1 < polys.size(); k += 10) {
+            const Poly& p = polys[k];
+            const Poly& q = polys[k + 1];
+            for (unsigned i = 0; i < 300; i += 7) {
+                tries ++;
+
+                Poly res1 = p + (q << i);
+                Poly res2 = p;
+                res2.addShifted(q, i);
+                Poly res3 = p;
+                res3.addShifted(res3, i);
+                Poly res4 = p;
+                res4.addShiftedBlocks(q, i / Poly::BLOCK_SIZE);
+
+                if ((res1 + res2).size() == 0 and (res3 + p + (p << i)).size() == 0 and
+                    (res4 + p + q.leftBlockShifted(i / Poly::BLOCK_SIZE)).size() == 0) {
+                    successes ++;
+                }
+            }
+        }
+
+        std::cout << "Shifted add success ratio : (" << successes << "/" << tries << ")" << std::endl;
+    }
+
+    // 6 - Bench the shift then add against the fused shifted add
+    {
+        int forceBench = 0;
+        Poly big = Poly::random(1 << 16, generator);
+        Poly r = big;
+        Poly shifted;
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (const Poly& p : polys) {
+            for (unsigned i = 0; i < 1 << 16; i += 4099) {
+                p.shiftLeft(i, shifted);
+                r += shifted;
+            }
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        forceBench += r.degree();
+
+        std::cout << "Shift then add took " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms" << std::endl;
+
+        r = big;
+        start = std::chrono::high_resolution_clock::now();
+        for (const Poly& p : polys) {
+            for (unsigned i = 0; i < 1 << 16; i += 4099) {
+                r.addShifted(p, i);
+            }
+        }
+        end = std::chrono::high_resolution_clock::now();
+        forceBench += r.degree();
+
+        volatile int forceBench2 = forceBench;
+        (void) forceBench2;
+
+        std::cout << "Shifted add took " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms" << std::endl;
+    }
+}
+
+typedef void (*BitwiseKernel)(const uint64_t*, const uint64_t*, unsigned, uint64_t*);
+typedef void (*ShiftKernel)(const uint64_t*, unsigned, unsigned, uint64_t*);
+
+void bench_block_kernels() {
+    std::default_random_engine generator;
+    generator.seed(getNanoseconds());
+
+    std::uniform_int_distribution<uint64_t> distrib;
+
+    // The portable, AVX2 and AVX-512 kernels, the ones the CPU doesn't have are skipped
+    const char* names[3] = {"Portable", "AVX2", "AVX-512"};
+    bool supported[3] = {true, hasAVX2(), hasAVX512()};
+    BitwiseKernel xors[3] = {xor_blocks, xor_blocks_avx2, xor_blocks_avx512};
+    BitwiseKernel ands[3] = {and_blocks, and_blocks_avx2, and_blocks_avx512};
+    BitwiseKernel ors[3] = {or_blocks, or_blocks_avx2, or_blocks_avx512};
+    ShiftKernel lefts[3] = {shift_left_blocks, shift_left_blocks_avx2, shift_left_blocks_avx512};
+    ShiftKernel rights[3] = {shift_right_blocks, shift_right_blocks_avx2, shift_right_blocks_avx512};
+
+    // 1 - Check the kernels against the definitions, out of place and in place
+    {
+        int tries = 0;
+        int successes = 0;
+
+        for (unsigned n = 0; n < 100; n++) {
+            std::vector<uint64_t> a(n), b(n);
+            for (unsigned i = 0; i < n; i++) {
+                a[i] = distrib(generator);
+                b[i] = distrib(generator);
+            }
+            unsigned shift = 1 + n % 63;
+
+            std::vector<uint64_t> xored(n), anded(n), ored(n), left(n), right(n);
+            for (unsigned i = 0; i < n; i++) {
+                xored[i] = a[i] ^ b[i];
+                anded[i] = a[i] & b[i];
+                ored[i] = a[i] | b[i];
+                left[i] = (a[i] << shift) | (i == 0 ? 0 : a[i - 1] >> (64 - shift));
+                right[i] = (a[i] >> shift) | (i + 1 == n ? 0 : a[i + 1] << (64 - shift));
+            }
+
+            for (unsigned k = 0; k < 3; k++) {
+                if (not supported[k]) {
+                    continue;
+                }
+                tries ++;
+
+                std::vector<uint64_t> res(n), inPlace(a);
+                bool ok = true;
+                xors[k](a.data(), b.data(), n, res.data());
+                ok = ok and res == xored;
+                ands[k](a.data(), b.data(), n, res.data());
+                ok = ok and res == anded;
+                ors[k](a.data(), b.data(), n, res.data());
+                ok = ok and res == ored;
+                lefts[k](a.data(), n, shift, res.data());
+                ok = ok and res == left;
+                rights[k](a.data(), n, shift, res.data());
+                ok = ok and res == right;
+                lefts[k](inPlace.data(), n, shift, inPlace.data());
+                ok = ok and inPlace == left;
+                inPlace = a;
+                rights[k](inPlace.data(), n, shift, inPlace.data());
+                ok = ok and inPlace == right;
+
+                if (ok) {
+                    successes ++;
+                }
+            }
+        }
+
+        std::cout << "Block kernels success ratio : (" << successes << "/" << tries << ")" << std::endl;
+    }
+
+    // 2 - Check the shifts and bitwise operators of Poly on multi-block polys
+    {
+        int tries = 0;
+        int successes = 0;
+
+        std::uniform_int_distribution<int> degreeDistrib(0, 4096);
+        for (unsigned k = 0; k < 300; k++) {
+            Poly p = Poly::random(degreeDistrib(generator), generator);
+            Poly q = Poly::random(degreeDistrib(generator), generator);
+            unsigned i = degreeDistrib(generator);
+            tries ++;
+
+            Poly left = p;
+            left <<= i;
+            Poly right = p;
+            right >>= i;
+            bool shiftsOk = (naiveShiftLeft(p, i) + (p << i)).size() == 0 and (left + (p << i)).size() == 0;
+            if ((int) i <= p.degree()) {
+                shiftsOk = shiftsOk and (naiveShiftRight(p, i) + (p >> i)).size() == 0 and (right + (p >> i)).size() == 0;
+            }
+
+            // p | q = p + q + (p & q) over GF(2), and p & q has the common bits
+            Poly both = p & q;
+            bool bitwiseOk = ((p | q) + p + q + both).size() == 0;
+            for (unsigned j = 0; j < p.size(); j += 61) {
+                bitwiseOk = bitwiseOk and both.bit(j) == (p.bit(j) & q.bit(j));
+            }
+
+            if (shiftsOk and bitwiseOk) {
+                successes ++;
+            }
+        }
+
+        std::cout << "Multi-block shifts and bitwise ops success ratio : (" << successes << "/" << tries << ")" << std::endl;
+    }
+
+    // 3 - Bench the kernels on 8 MB arrays, past the caches
+    {
+        std::vector<uint64_t> a(1 << 20), b(1 << 20), res(1 << 20);
+        for (unsigned i = 0; i < a.size(); i++) {
+            a[i] = distrib(generator);
+            b[i] = distrib(generator);
+        }
+
+        for (unsigned k = 0; k < 3; k++) {
+            if (not supported[k]) {
+                continue;
+            }
+
+            auto start = std::chrono::high_resolution_clock::now();
+            for (unsigned j = 0; j < 10; j++) {
+                xors[k](a.data(), b.data(), a.size(), res.data());
+            }
+            auto middle = std::chrono::high_resolution_clock::now();
+            for (unsigned j = 0; j < 10; j++) {
+                lefts[k](a.data(), a.size(), 37, res.data());
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+
+            std::cout << names[k] << " 10 xors of 8 MB took " << std::chrono::duration_cast<std::chrono::microseconds>(middle - start).count() << " us, 10 shifts took " << std::chrono::duration_cast<std::chrono::microseconds>(end - middle).count() << " us" << std::endl;
+        }
+    }
 }
 
 void bench_division() {
@@ -221,7 +512,7 @@ void bench_division() {
                 Poly q, r;
                 p1.euclidianDivision(p2, q, r);
 
-                if ((p1 + q * p2 + r).size() == 0) {
+                if ((p1 + q * p2 + r).size() == 0 and r.degree() < p2.degree()) {
                     successes ++;
                 }
             }
@@ -251,8 +542,1489 @@ void bench_division() {
     }
 }
 
+void bench_big() {
+    std::default_random_engine generator;
+    generator.seed(getNanoseconds());
+
+    std::uniform_int_distribution<int> degreeDistrib(256, 2048);
+
+    std::vector<Poly> polys;
+
+    for (int i = 0;  i < 10; i++) {
+        polys.push_back(Poly::random(degreeDistrib(generator), generator));
+    }
+
+    // 1 - Check Correctness of karatsubas on polys that don't fit inline
+    {
+        int tries = 0;
+        int successes = 0;
+
+        for (const Poly& p : polys) {
+            for (const Poly& q : polys) {
+                tries ++;
+
+                Poly res1 = p.multiplyNaively(q);
+                Poly res2 = p.multiplyKaratsuba32(q);
+
+                if ((res1 + res2).size() == 0) {
+                    successes ++;
+                }
+            }
+        }
+
+        std::cout << "Big Karatsuba32 success ratio : (" << successes << "/" << tries << ")" << std::endl;
+    }
+
+    // 2 - Check Correctness of the division of the products
+    {
+        int tries = 0;
+        int successes = 0;
+
+        for (const Poly& p1 : polys) {
+            for (const Poly& p2 : polys) {
+                tries ++;
+
+                Poly q, r;
+                Poly p = p1 * p2 + p2;
+                p.euclidianDivision(p1, q, r);
+
+                if ((p + q * p1 + r).size() == 0 and r.degree() < p1.degree()) {
+                    successes ++;
+                }
+            }
+        }
+
+        std::cout << "Big division success ratio : (" << successes << "/" << tries << ")" << std::endl;
+    }
+
+    // 3 - Check that moved-from polys, inline or spilled, are still usable
+    {
+        int tries = 0;
+        int successes = 0;
+
+        Poly x100 = Poly::fromInt(1) << 100;
+        for (const Poly& p : polys) {
+            tries ++;
+
+            Poly small = Poly::fromInt(5);
+            Poly stolen(std::move(small));
+            small.addShifted(Poly::fromInt(1), 100);
+
+            Poly big = p;
+            Poly stolenBig(std::move(big));
+            big.addShifted(Poly::fromInt(1), 100);
+
+            Poly target = Poly::fromInt(7);
+            Poly source = p;
+            target = std::move(source);
+
+            Poly bigTarget = p * p;
+            Poly bigSource = p;
+            bigTarget = std::move(bigSource);
+
+            Poly inlineTarget = p;
+            Poly inlineSource = Poly::fromInt(3);
+            inlineTarget = std::move(inlineSource);
+
+            // The sources of the assignments may be left with any value,
+            // their top bit must still be at their degree
+            if ((small + x100).size() == 0 and (big + x100).size() == 0 and
+                (stolen + Poly::fromInt(5)).size() == 0 and (stolenBig + p).size() == 0 and
+                (target + p).size() == 0 and (bigTarget + p).size() == 0 and
+                (inlineTarget + Poly::fromInt(3)).size() == 0 and
+                (source.size() == 0 or source.bit(source.degree()) == 1) and
+                (bigSource.size() == 0 or bigSource.bit(bigSource.degree()) == 1)) {
+                successes ++;
+            }
+        }
+
+        std::cout << "Moved-from polys success ratio : (" << successes << "/" << tries << ")" << std::endl;
+    }
+
+    // 4 - Check that growing a workspace keeps the blocks in use in place
+    {
+        int tries = 0;
+        int successes = 0;
+
+        Workspace workspace;
+        for (unsigned n = 1; n < 2000; n = 2 * n + 1) {
+            tries ++;
+
+            workspace.reserve(n);
+            unsigned mark = workspace.mark();
+            Poly::Block* first = workspace.allocate(n);
+            for (unsigned i = 0; i < n; i++) {
+                first[i] = i;
+            }
+
+            // Doesn't fit after first, a chunk is added
+            workspace.reserve(3 * n);
+            Poly::Block* second = workspace.allocate(3 * n);
+            for (unsigned i = 0; i < 3 * n; i++) {
+                second[i] = ~(Poly::Block) 0;
+            }
+
+            bool kept = true;
+            for (unsigned i = 0; i < n; i++) {
+                kept = kept and first[i] == i;
+            }
+            workspace.release(mark);
+
+            // With nothing in use the chunks are merged back into one
+            workspace.reserve(workspace.capacity() + 1);
+            Poly::Block* all = workspace.allocate(workspace.capacity());
+            all[0] = 0;
+
+            if (kept and workspace.mark() == workspace.capacity()) {
+                successes ++;
+            }
+            workspace.release(mark);
+        }
+
+        std::cout << "Workspace growth success ratio : (" << successes << "/" << tries << ")" << std::endl;
+    }
+}
+
+void bench_kernels() {
+    std::default_random_engine generator;
+    generator.seed(getNanoseconds());
+
+    std::uniform_int_distribution<uint64_t> distrib;
+
+    std::vector<uint64_t> words;
+
+    for (int i = 0;  i < 1000; i++) {
+        words.push_back(distrib(generator));
+    }
+
+    // 1 - Check the bitsliced kernels on a size that isn't a multiple of the batches
+    {
+        int tries = 0;
+        int successes = 0;
+
+        std::vector<uint64_t> shifted(words.begin() + 1, words.end());
+        shifted.push_back(words[0]);
+        unsigned n = words.size();
+        std::vector<uint64_t> high1(n), low1(n), high2(n), low2(n);
+        convolution_64_128_batch(words.data(), shifted.data(), n, high1.data(), low1.data());
+        if (hasAVX2()) {
+            convolution_64_128_batch_avx2(words.data(), shifted.data(), n, high2.data(), low2.data());
+        } else {
+            convolution_64_128_batch(words.data(), shifted.data(), n, high2.data(), low2.data());
+        }
+
+        for (unsigned i = 0; i < n; i++) {
+            tries ++;
+
+            uint64_t high, low;
+            convolution_64_128(words[i], shifted[i], high, low);
+            if (high == high1[i] and low == low1[i] and high == high2[i] and low == low2[i]) {
+                successes ++;
+            }
+        }
+
+        std::cout << "Bitsliced kernels success ratio : (" << successes << "/" << tries << ")" << std::endl;
+    }
+
+    // 2 - Check the comb kernels against the bit by bit ones
+    {
+        int tries = 0;
+        int successes = 0;
+
+        for (uint64_t a : words) {
+            for (uint64_t b : words) {
+                tries ++;
+
+                uint64_t high1, low1, high2, low2;
+                convolution_64_128(a, b, high1, low1);
+                convolution_64_128_comb(a, b, high2, low2);
+
+                if (high1 == high2 and low1 == low2 and
+                        convolution_32_64(a, b) == convolution_32_64_comb(a, b) and
+                        convolution_16_32(a, b) == convolution_16_32_comb(a, b)) {
+                    successes ++;
+                }
+            }
+        }
+
+        // The top bits of b are the ones the 64 bits comb handles apart
+        for (uint64_t a : words) {
+            for (uint64_t b : {~(uint64_t) 0, (uint64_t) 1 << 63, (uint64_t) 7 << 61, (uint64_t) 5 << 60}) {
+                tries ++;
+
+                uint64_t high1, low1, high2, low2;
+                convolution_64_128(a, b, high1, low1);
+                convolution_64_128_comb(a, b, high2, low2);
+
+                if (high1 == high2 and low1 == low2) {
+                    successes ++;
+                }
+            }
+        }
+
+        std::cout << "Comb kernels success ratio : (" << successes << "/" << tries << ")" << std::endl;
+    }
+
+    // 3 - Bench the bit by bit and comb kernels
+    {
+        const char* names[2] = {"Portable", "Comb"};
+        void (*kernels64[2])(uint64_t, uint64_t, uint64_t&, uint64_t&) = {convolution_64_128, convolution_64_128_comb};
+        uint64_t (*kernels32[2])(uint32_t, uint32_t) = {convolution_32_64, convolution_32_64_comb};
+        uint32_t (*kernels16[2])(uint16_t, uint16_t) = {convolution_16_32, convolution_16_32_comb};
+
+        for (unsigned i = 0; i < 2; i++) {
+            uint64_t forceBench = 0;
+
+            auto start = std::chrono::high_resolution_clock::now();
+            for (uint64_t a : words) {
+                for (uint64_t b : words) {
+                    uint64_t high, low;
+                    kernels64[i](a, b, high, low);
+                    forceBench ^= high ^ low;
+                }
+            }
+            auto mid32 = std::chrono::high_resolution_clock::now();
+            for (uint64_t a : words) {
+                for (uint64_t b : words) {
+                    forceBench ^= kernels32[i](a, b);
+                }
+            }
+            auto mid16 = std::chrono::high_resolution_clock::now();
+            for (uint64_t a : words) {
+                for (uint64_t b : words) {
+                    forceBench ^= kernels16[i](a, b);
+                }
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+
+            volatile uint64_t forceBench2 = forceBench;
+            (void) forceBench2;
+
+            std::cout << names[i] << " 64x64 took " << std::chrono::duration_cast<std::chrono::milliseconds>(mid32 - start).count() << " ms, ";
+            std::cout << "32x32 took " << std::chrono::duration_cast<std::chrono::milliseconds>(mid16 - mid32).count() << " ms, ";
+            std::cout << "16x16 took " << std::chrono::duration_cast<std::chrono::milliseconds>(end - mid16).count() << " ms" << std::endl;
+        }
+    }
+
+    // 4 - Bench the batch kernels, 64 products per word with the bitsliced ones
+    {
+        std::vector<uint64_t> a(1 << 16), b(1 << 16), high(1 << 16), low(1 << 16);
+        for (unsigned i = 0; i < a.size(); i++) {
+            a[i] = words[i % words.size()];
+            b[i] = words[(i / words.size() + i) % words.size()];
+        }
+
+        const char* names[3] = {"Bitsliced", "Bitsliced AVX2", "CLMUL"};
+        void (*kernels[3])(const uint64_t*, const uint64_t*, unsigned, uint64_t*, uint64_t*) = {
+            convolution_64_128_batch, convolution_64_128_batch_avx2, convolution_64_128_batch_clmul
+        };
+        for (unsigned i = 0; i < 3; i++) {
+            auto start = std::chrono::high_resolution_clock::now();
+            kernels[i](a.data(), b.data(), a.size(), high.data(), low.data());
+            auto end = std::chrono::high_resolution_clock::now();
+
+            std::cout << names[i] << " batch of 65536 64x64 took " << std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << " us" << std::endl;
+        }
+    }
+
+    if (not hasCLMUL()) {
+        std::cout << "No CLMUL on this CPU, skipping the hardware kernels" << std::endl;
+        return;
+    }
+
+    // 5 - Check the hardware kernels against the portable ones
+    {
+        int tries = 0;
+        int successes = 0;
+
+        for (uint64_t a : words) {
+            for (uint64_t b : words) {
+                tries ++;
+
+                uint64_t high1, low1, high2, low2;
+                convolution_64_128(a, b, high1, low1);
+                convolution_64_128_clmul(a, b, high2, low2);
+
+                if (high1 == high2 and low1 == low2 and
+                        convolution_32_64(a, b) == convolution_32_64_clmul(a, b) and
+                        convolution_16_32(a, b) == convolution_16_32_clmul(a, b)) {
+                    successes ++;
+                }
+            }
+        }
+
+        std::cout << "CLMUL kernels success ratio : (" << successes << "/" << tries << ")" << std::endl;
+    }
+
+    // 6 - Check the squaring kernels against the multiplication
+    {
+        int tries = 0;
+        int successes = 0;
+
+        for (uint64_t a : words) {
+            tries ++;
+
+            uint64_t high1, low1, high2, low2, high3, low3, high4, low4;
+            convolution_64_128(a, a, high1, low1);
+            square_64_128(a, high2, low2);
+            square_64_128_clmul(a, high3, low3);
+            if (hasBMI2()) {
+                square_64_128_pdep(a, high4, low4);
+            } else {
+                square_64_128(a, high4, low4);
+            }
+
+            if (high1 == high2 and low1 == low2 and high1 == high3 and low1 == low3 and high1 == high4 and low1 == low4) {
+                successes ++;
+            }
+        }
+
+        std::cout << "Squaring kernels success ratio : (" << successes << "/" << tries << ")" << std::endl;
+    }
+
+    // 7 - Bench the hardware 64x64 kernel
+    {
+        uint64_t forceBench = 0;
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (uint64_t a : words) {
+            for (uint64_t b : words) {
+                uint64_t high, low;
+                convolution_64_128_clmul(a, b, high, low);
+                forceBench ^= high ^ low;
+            }
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+
+        volatile uint64_t forceBench2 = forceBench;
+        (void) forceBench2;
+
+        std::cout << "CLMUL 64x64 took " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms" << std::endl;
+    }
+}
+
+void bench_algorithms() {
+    std::default_random_engine generator;
+    generator.seed(getNanoseconds());
+
+    const char* names[] = {"Basecase", "Karatsuba", "Toom3", "FFT"};
+    Poly::MultiplyThresholds thresholds[] = {
+        {UINT_MAX, UINT_MAX, UINT_MAX},
+        Poly::KARATSUBA_ONLY,
+        {Poly::multiplyThresholds.karatsuba, 7, UINT_MAX},
+        {Poly::multiplyThresholds.karatsuba, Poly::multiplyThresholds.toom3, 2},
+    };
+
+    // 1 - Check that all the algorithms agree
+    {
+        std::uniform_int_distribution<int> degreeDistrib(64, 8192);
+
+        int tries = 0;
+        int successes = 0;
+
+        for (int i = 0; i < 100; i++) {
+            Poly p = Poly::random(degreeDistrib(generator), generator);
+            Poly q = Poly::random(degreeDistrib(generator), generator);
+
+            Poly res1;
+            p.multiply(q, res1, thresholds[0]);
+
+            for (unsigned j = 1; j < 4; j++) {
+                tries ++;
+
+                Poly res2;
+                p.multiply(q, res2, thresholds[j]);
+
+                if ((res1 + res2).size() == 0) {
+                    successes ++;
+                }
+            }
+        }
+
+        std::cout << "Multiplication algorithms success ratio : (" << successes << "/" << tries << ")" << std::endl;
+    }
+
+    // 2 - Bench them on growing sizes
+    for (unsigned degree = 1 << 12; degree <= 1 << 20; degree <<= 2) {
+        Poly p = Poly::random(degree, generator);
+        Poly q = Poly::random(degree, generator);
+
+        for (unsigned j = 0; j < 4; j++) {
+            if (j == 0 and degree > 1 << 16) {
+                continue;
+            }
+
+            Poly r;
+            auto start = std::chrono::high_resolution_clock::now();
+            p.multiply(q, r, thresholds[j]);
+            auto end = std::chrono::high_resolution_clock::now();
+
+            std::cout << names[j] << " degree " << degree << " took " << std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << " us" << std::endl;
+        }
+    }
+}
+
+void bench_big_division() {
+    std::default_random_engine generator;
+    generator.seed(getNanoseconds());
+
+    std::uniform_int_distribution<int> degreeDistrib(1 << 14, 1 << 16);
+    unsigned defaultThreshold = Poly::newtonDivisionThreshold;
+
+    // 1 - Check the Newton division against the block division
+    {
+        int tries = 0;
+        int successes = 0;
+
+        for (int i = 0; i < 20; i++) {
+            tries ++;
+
+            Poly b = Poly::random(degreeDistrib(generator), generator);
+            Poly a = Poly::random(b.degree() + degreeDistrib(generator), generator);
+            Poly q1, r1, q2, r2;
+
+            Poly::newtonDivisionThreshold = UINT_MAX;
+            a.euclidianDivision(b, q1, r1);
+            Poly::newtonDivisionThreshold = 0;
+            a.euclidianDivision(b, q2, r2);
+
+            if ((q1 + q2).size() == 0 and (r1 + r2).size() == 0 and (a + q1 * b + r1).size() == 0) {
+                successes ++;
+            }
+        }
+
+        std::cout << "Newton division success ratio : (" << successes << "/" << tries << ")" << std::endl;
+    }
+
+    // 2 - Bench both divisions of a degree 2^17 poly by a degree 2^16 one
+    {
+        Poly b = Poly::random(1 << 16, generator);
+        Poly a = Poly::random(1 << 17, generator);
+        Poly q, r;
+
+        Poly::newtonDivisionThreshold = UINT_MAX;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < 10; i++) {
+            a.euclidianDivision(b, q, r);
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+
+        std::cout << "Block division degree 131072 took " << std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 10 << " us" << std::endl;
+
+        Poly::newtonDivisionThreshold = 0;
+        start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < 10; i++) {
+            a.euclidianDivision(b, q, r);
+        }
+        end = std::chrono::high_resolution_clock::now();
+
+        std::cout << "Newton division degree 131072 took " << std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 10 << " us" << std::endl;
+    }
+
+    Poly::newtonDivisionThreshold = defaultThreshold;
+}
+
+void bench_parallel_multiply() {
+    std::default_random_engine generator;
+    generator.seed(getNanoseconds());
+
+    ThreadPool& pool = ThreadPool::global();
+    unsigned defaultThreads = pool.numThreads();
+    std::vector<unsigned> threadCounts = {1, 2, 4, 8};
+    if (defaultThreads > 8) {
+        threadCounts.push_back(defaultThreads);
+    }
+
+    // Check each thread count against the sequential product then bench
+    // them, more threads than cores only checks the tasks work. The sizes
+    // stay below the FFT threshold.
+    for (int degree = 1 << 17; degree <= 1 << 19; degree *= 4) {
+        Poly a = Poly::random(degree, generator);
+        Poly b = Poly::random(degree, generator);
+
+        pool.resize(1);
+        Poly expected = a * b;
+
+        int tries = 0;
+        int successes = 0;
+        for (unsigned threads : threadCounts) {
+            pool.resize(threads);
+
+            auto start = std::chrono::high_resolution_clock::now();
+            Poly res = a * b;
+            auto end = std::chrono::high_resolution_clock::now();
+
+            tries ++;
+            if ((res + expected).size() == 0) {
+                successes ++;
+            }
+            std::cout << "Parallel multiply degree " << degree << " on " << threads << " threads took "
+                << std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << " us" << std::endl;
+        }
+
+        std::cout << "Parallel multiply success ratio : (" << successes << "/" << tries << ")" << std::endl;
+    }
+
+    // The tasks that throw are still counted done and wait() rethrows
+    {
+        pool.resize(4);
+
+        int tries = 0;
+        int successes = 0;
+        for (int i = 0; i < 100; i++) {
+            std::atomic<unsigned> ran(0);
+            TaskGroup group(pool);
+            for (int j = 0; j < 8; j++) {
+                group.run([&ran, i, j]() {
+                    ran ++;
+                    if ((i + j) % 3 == 0) {
+                        throw std::runtime_error("task failed");
+                    }
+                });
+            }
+
+            tries ++;
+            try {
+                group.wait();
+            } catch (const std::runtime_error&) {
+                if (ran.load() == 8) {
+                    successes ++;
+                }
+            }
+        }
+
+        std::cout << "Throwing tasks success ratio : (" << successes << "/" << tries << ")" << std::endl;
+    }
+
+    pool.resize(defaultThreads);
+}
+
+Poly polyFromExponents(std::vector<unsigned> exponents) {
+    Poly res;
+    for (unsigned e : exponents) {
+        res.addShifted(Poly::fromInt(1), e);
+    }
+    return res;
+}
+
+void bench_modulus() {
+    std::default_random_engine generator;
+    generator.seed(getNanoseconds());
+
+    std::vector<Poly> moduli = {
+        polyFromExponents({233, 74, 0}),
+        polyFromExponents({571, 10, 5, 2, 0}),
+        Poly::random(233, generator),
+        Poly::random(1000, generator),
+        Poly::random(30000, generator),
+    };
+
+    // 1 - Check the reductions against the division
+    {
+        int tries = 0;
+        int successes = 0;
+
+        for (const Poly& f : moduli) {
+            PolyModulus modulus(f);
+
+            for (int i = 0; i < 20; i++) {
+                tries ++;
+
+                Poly a = Poly::random(f.degree() - 1, generator);
+                Poly b = Poly::random(f.degree() - 1, generator);
+                Poly big = Poly::random(3 * f.degree(), generator);
+                Poly q, product, square, reduced;
+                (a * b).euclidianDivision(f, q, product);
+                (a * a).euclidianDivision(f, q, square);
+                big.euclidianDivision(f, q, reduced);
+
+                Poly bigReduced = big;
+                modulus.reduce(bigReduced);
+
+                // a^5 = a^2 * a^2 * a
+                Poly power = modulus.mulmod(modulus.mulmod(square, square), a);
+
+                if ((modulus.mulmod(a, b) + product).size() == 0 and
+                    (modulus.sqrmod(a) + square).size() == 0 and
+                    (bigReduced + reduced).size() == 0 and
+                    (modulus.powmod(a, 5) + power).size() == 0) {
+                    successes ++;
+                }
+            }
+        }
+
+        std::cout << "Modulus success ratio : (" << successes << "/" << tries << ")" << std::endl;
+    }
+
+    // 2 - Bench mulmod against a multiplication followed by a division
+    for (const Poly& f : moduli) {
+        PolyModulus modulus(f);
+        int iterations = 3000000 / f.degree();
+
+        Poly a = Poly::random(f.degree() - 1, generator);
+        Poly b = Poly::random(f.degree() - 1, generator);
+        Poly q, r, product;
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < iterations; i++) {
+            a.multiply(b, product);
+            product.euclidianDivision(f, q, r);
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+
+        std::cout << "Degree " << f.degree() << " multiply and divide took " << std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / iterations << " ns" << std::endl;
+
+        start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < iterations; i++) {
+            modulus.mulmod(a, b, r);
+        }
+        end = std::chrono::high_resolution_clock::now();
+
+        std::cout << "Degree " << f.degree() << " mulmod took " << std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / iterations << " ns" << std::endl;
+    }
+}
+
+Poly euclidGcd(Poly a, Poly b) {
+    while (b.size() != 0) {
+        Poly q, r;
+        a.euclidianDivision(b, q, r);
+        a = b;
+        b = r;
+    }
+    return a;
+}
+
+void bench_gcd() {
+    std::default_random_engine generator;
+    generator.seed(getNanoseconds());
+
+    std::uniform_int_distribution<int> degreeDistrib(0, 4096);
+
+    // 1 - Check gcd and extendedGcd against Euclid's algorithm, with common
+    // factors and powers of x, on both the binary and the half GCD
+    {
+        int tries = 0;
+        int successes = 0;
+
+        unsigned defaultThreshold = Poly::halfGcdThreshold;
+        unsigned defaultExtendedThreshold = Poly::halfExtendedGcdThreshold;
+
+        for (int i = 0; i < 200; i++) {
+            Poly common = Poly::random(degreeDistrib(generator) / 8, generator) << (i % 3);
+            Poly a = Poly::random(degreeDistrib(generator), generator) * common;
+            Poly b = Poly::random(degreeDistrib(generator), generator) * common << (i % 5);
+            Poly expected = euclidGcd(a, b);
+
+            for (unsigned threshold : {UINT_MAX, 1u}) {
+                tries ++;
+
+                Poly::halfGcdThreshold = threshold;
+                Poly::halfExtendedGcdThreshold = threshold;
+                Poly g, u, v;
+                a.extendedGcd(b, g, u, v);
+
+                if ((a.gcd(b) + expected).size() == 0 and (g + expected).size() == 0 and (u * a + v * b + g).size() == 0 and
+                    u.degree() < b.degree() - g.degree() and v.degree() < a.degree() - g.degree()) {
+                    successes ++;
+                }
+            }
+        }
+
+        Poly::halfGcdThreshold = defaultThreshold;
+        Poly::halfExtendedGcdThreshold = defaultExtendedThreshold;
+
+        std::cout << "GCD success ratio : (" << successes << "/" << tries << ")" << std::endl;
+    }
+
+    // 2 - Bench the gcd and extended gcd against Euclid's algorithm
+    for (int degree = 1024; degree <= 65536; degree *= 4) {
+        Poly a = Poly::random(degree, generator);
+        Poly b = Poly::random(degree - 1, generator);
+        Poly g, u, v;
+
+        auto start = std::chrono::high_resolution_clock::now();
+        g = euclidGcd(a, b);
+        auto end = std::chrono::high_resolution_clock::now();
+
+        std::cout << "Euclid GCD degree " << degree << " took " << std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << " us" << std::endl;
+
+        start = std::chrono::high_resolution_clock::now();
+        g = a.gcd(b);
+        end = std::chrono::high_resolution_clock::now();
+
+        std::cout << "GCD degree " << degree << " took " << std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << " us" << std::endl;
+
+        start = std::chrono::high_resolution_clock::now();
+        a.extendedGcd(b, g, u, v);
+        end = std::chrono::high_resolution_clock::now();
+
+        std::cout << "Extended GCD degree " << degree << " took " << std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << " us" << std::endl;
+    }
+}
+
+Poly productOfFactors(const std::vector<PolyFactor>& factors) {
+    Poly res = Poly::fromInt(1);
+    for (const PolyFactor& factor : factors) {
+        for (unsigned i = 0; i < factor.multiplicity; i++) {
+            res *= factor.poly;
+        }
+    }
+    return res;
+}
+
+void bench_factor() {
+    std::default_random_engine generator;
+    generator.seed(getNanoseconds());
+
+    // 1 - Check the factorization of products of known irreducible polys
+    {
+        std::vector<Poly> irreducibles = {
+            polyFromExponents({1}),
+            polyFromExponents({1, 0}),
+            polyFromExponents({2, 1, 0}),
+            polyFromExponents({3, 1, 0}),
+            polyFromExponents({3, 2, 0}),
+            polyFromExponents({4, 1, 0}),
+            polyFromExponents({233, 74, 0}),
+            polyFromExponents({571, 10, 5, 2, 0}),
+        };
+        std::uniform_int_distribution<int> multiplicityDistrib(0, 5);
+
+        int tries = 0;
+        int successes = 0;
+
+        for (int i = 0; i < 100; i++) {
+            tries ++;
+
+            Poly f = Poly::fromInt(1);
+            std::vector<unsigned> multiplicities;
+            for (const Poly& irreducible : irreducibles) {
+                multiplicities.push_back(multiplicityDistrib(generator));
+                for (unsigned j = 0; j < multiplicities.back(); j++) {
+                    f *= irreducible;
+                }
+            }
+
+            std::vector<PolyFactor> factors = factor(f);
+            bool success = (productOfFactors(factors) + f).size() == 0;
+            for (const PolyFactor& factor : factors) {
+                for (unsigned j = 0; j < irreducibles.size(); j++) {
+                    if ((factor.poly + irreducibles[j]).size() == 0) {
+                        success = success and factor.multiplicity == multiplicities[j];
+                        multiplicities[j] = 0;
+                    }
+                }
+            }
+            for (unsigned multiplicity : multiplicities) {
+                success = success and multiplicity == 0;
+            }
+
+            if (success) {
+                successes ++;
+            }
+        }
+
+        std::cout << "Factorization success ratio : (" << successes << "/" << tries << ")" << std::endl;
+    }
+
+    // 2 - Check random polys give back their product and irreducible factors
+    {
+        std::uniform_int_distribution<int> degreeDistrib(1, 300);
+
+        int tries = 0;
+        int successes = 0;
+
+        for (int i = 0; i < 100; i++) {
+            tries ++;
+
+            Poly f = Poly::random(degreeDistrib(generator), generator);
+            std::vector<PolyFactor> factors = factor(f);
+            bool success = (productOfFactors(factors) + f).size() == 0;
+            for (const PolyFactor& factor : factors) {
+                std::vector<PolyFactor> again = squarefreeDecomposition(factor.poly);
+                std::vector<DistinctDegreeFactor> degrees = distinctDegreeFactorization(factor.poly);
+                success = success and again.size() == 1 and again[0].multiplicity == 1 and
+                    degrees.size() == 1 and degrees[0].degree == (unsigned) factor.poly.degree();
+            }
+
+            if (success) {
+                successes ++;
+            }
+        }
+
+        std::cout << "Random factorization success ratio : (" << successes << "/" << tries << ")" << std::endl;
+    }
+
+    // 3 - Bench the factorizations per second of random polys
+    for (int degree = 64; degree <= 4096; degree *= 4) {
+        std::vector<Poly> polys;
+        int count = std::max(4, 200000 / degree / degree * 64);
+        for (int i = 0; i < count; i++) {
+            polys.push_back(Poly::random(degree, generator));
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        std::vector<std::vector<PolyFactor>> factorizations = factorBatch(polys);
+        auto end = std::chrono::high_resolution_clock::now();
+
+        double seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1e6;
+        std::cout << "Factorization degree " << degree << " : " << (int) (count / seconds) << " per second" << std::endl;
+    }
+}
+
+void bench_irreducible() {
+    std::default_random_engine generator;
+    generator.seed(getNanoseconds());
+
+    // 1 - Check known irreducible polys and products of them
+    {
+        std::vector<Poly> irreducibles = {
+            polyFromExponents({1}),
+            polyFromExponents({1, 0}),
+            polyFromExponents({2, 1, 0}),
+            polyFromExponents({8, 4, 3, 1, 0}),
+            polyFromExponents({233, 74, 0}),
+            polyFromExponents({571, 10, 5, 2, 0}),
+        };
+
+        int tries = 0;
+        int successes = 0;
+
+        for (unsigned i = 0; i < irreducibles.size(); i++) {
+            tries ++;
+            if (isIrreducible(irreducibles[i])) {
+                successes ++;
+            }
+            for (unsigned j = i; j < irreducibles.size(); j++) {
+                tries ++;
+                if (not isIrreducible(irreducibles[i] * irreducibles[j])) {
+                    successes ++;
+                }
+            }
+        }
+
+        std::cout << "Known irreducibility success ratio : (" << successes << "/" << tries << ")" << std::endl;
+    }
+
+    // 2 - Check random polys against their factorization
+    {
+        std::uniform_int_distribution<int> degreeDistrib(0, 300);
+
+        int tries = 0;
+        int successes = 0;
+
+        for (int i = 0; i < 300; i++) {
+            tries ++;
+
+            Poly f = Poly::random(degreeDistrib(generator), generator);
+            // Many more irreducible ones than with uniform polys
+            if (f.degree() > 0 and i % 2 == 0) {
+                f = factor(f).back().poly;
+            }
+
+            bool irreducible = false;
+            if (f.degree() > 0) {
+                std::vector<PolyFactor> factors = factor(f);
+                irreducible = factors.size() == 1 and factors[0].multiplicity == 1;
+            }
+
+            if (isIrreducible(f) == irreducible) {
+                successes ++;
+            }
+        }
+
+        std::cout << "Random irreducibility success ratio : (" << successes << "/" << tries << ")" << std::endl;
+    }
+
+    // 3 - Bench the tests per second of random polys with a constant term
+    for (int degree = 64; degree <= 4096; degree *= 4) {
+        std::vector<Poly> polys;
+        int count = std::max(1000, 1000000 / degree / degree * 64);
+        for (int i = 0; i < count; i++) {
+            polys.push_back(Poly::random(degree, generator) + Poly::fromInt(1));
+        }
+
+        int found = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (const Poly& p : polys) {
+            found += isIrreducible(p);
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+
+        double seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1e6;
+        std::cout << "Irreducibility test degree " << degree << " : " << (int) (count / seconds) << " per second, "
+            << found << " irreducible out of " << count << std::endl;
+    }
+
+    // 4 - Bench the search of irreducible polys and check it is the same on one thread
+    {
+        std::vector<Poly> candidates;
+        for (int i = 0; i < 10000; i++) {
+            candidates.push_back(Poly::random(1024, generator));
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        std::vector<Poly> found = findIrreducibles(candidates, 4);
+        auto end = std::chrono::high_resolution_clock::now();
+        std::vector<Poly> sequential = findIrreducibles(candidates, 4, 1);
+
+        bool success = found.size() == 4 and sequential.size() == 4;
+        for (unsigned i = 0; success and i < found.size(); i++) {
+            success = (found[i] + sequential[i]).size() == 0 and found[i].degree() == 1024;
+        }
+
+        std::cout << "Search of 4 irreducible polys of degree 1024 : "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms, "
+            << (success ? "same as sequential" : "FAILED") << std::endl;
+    }
+}
+
+void bench_corpus() {
+    std::default_random_engine generator;
+    generator.seed(getNanoseconds());
+
+    std::uniform_int_distribution<int> degreeDistrib(0, 1000);
+
+    // Small and multi-block polys, 0 and a heap sized one
+    std::vector<Poly> polys;
+    polys.push_back(Poly());
+    for (int i = 0; i < 100000; i++) {
+        polys.push_back(Poly::random(degreeDistrib(generator), generator));
+    }
+    polys.push_back(Poly::random(1 << 16, generator));
+
+    const char* path = "poly_corpus_check.bin";
+
+    // 1 - Check the polys read back are the ones written, then that a
+    // truncated file stops at its last whole record and a corrupt one at
+    // the corrupt record
+    {
+        int tries = 0;
+        int successes = 0;
+
+        PolyCorpusWriter writer;
+        bool written = writer.open(path);
+        for (const Poly& p : polys) {
+            written = written and writer.write(p);
+        }
+        written = writer.close() and written;
+
+        // Nothing is written once the writer is closed
+        tries ++;
+        if (not writer.write(polys[1])) {
+            successes ++;
+        }
+
+        PolyCorpusReader reader;
+        tries ++;
+        if (written and reader.open(path) and reader.size() == polys.size()) {
+            successes ++;
+        }
+
+        unsigned i = 0;
+        for (const Poly& p : reader) {
+            tries ++;
+            if (i < polys.size() and p.degree() == polys[i].degree() and (p + polys[i]).size() == 0) {
+                successes ++;
+            }
+            i ++;
+        }
+        tries ++;
+        if (i == polys.size()) {
+            successes ++;
+        }
+        reader.close();
+
+        std::vector<char> bytes;
+        std::FILE* file = std::fopen(path, "rb");
+        for (int c = std::fgetc(file); c != EOF; c = std::fgetc(file)) {
+            bytes.push_back(c);
+        }
+        std::fclose(file);
+        file = std::fopen(path, "wb");
+        std::fwrite(bytes.data(), 1, bytes.size() - 8, file);
+        std::fclose(file);
+
+        unsigned nRead = 0;
+        reader.open(path);
+        for (auto it = reader.begin(); it != reader.end(); ++it) {
+            nRead ++;
+        }
+        tries ++;
+        if (nRead == polys.size() - 1) {
+            successes ++;
+        }
+        reader.close();
+
+        // The blocks of the second record, after the 0 poly, are at 192.
+        // Clearing its top block makes it disagree with its degree.
+        int degree = polys[1].degree();
+        std::memset(bytes.data() + 192 + degree / Poly::BLOCK_SIZE * sizeof(Poly::Block), 0, sizeof(Poly::Block));
+        file = std::fopen(path, "wb");
+        std::fwrite(bytes.data(), 1, bytes.size(), file);
+        std::fclose(file);
+
+        nRead = 0;
+        reader.open(path);
+        for (auto it = reader.begin(); it != reader.end(); ++it) {
+            nRead ++;
+        }
+        tries ++;
+        if (degree < 0 or nRead == 1) {
+            successes ++;
+        }
+
+        std::cout << "Corpus success ratio : (" << successes << "/" << tries << ")" << std::endl;
+    }
+
+    // 2 - Bench writing the corpus, then multiplying consecutive polys of
+    // the mapped views against the same with the polys in memory
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        PolyCorpusWriter writer;
+        writer.open(path);
+        for (const Poly& p : polys) {
+            writer.write(p);
+        }
+        writer.close();
+        auto end = std::chrono::high_resolution_clock::now();
+
+        std::cout << "Writing " << polys.size() << " polys took " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms" << std::endl;
+    }
+
+    {
+        int forceBench = 0;
+        Poly product;
+
+        auto start = std::chrono::high_resolution_clock::now();
+        PolyCorpusReader reader;
+        reader.open(path);
+        Poly previous;
+        for (const Poly& p : reader) {
+            previous.multiply(p, product);
+            forceBench += product.degree();
+            previous = p;
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+
+        std::cout << "Mapping and multiplying took " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms" << std::endl;
+
+        start = std::chrono::high_resolution_clock::now();
+        for (unsigned i = 1; i < polys.size(); i++) {
+            polys[i - 1].multiply(polys[i], product);
+            forceBench += product.degree();
+        }
+        end = std::chrono::high_resolution_clock::now();
+
+        volatile int forceBench2 = forceBench;
+        (void) forceBench2;
+
+        std::cout << "Multiplying in memory took " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms" << std::endl;
+    }
+
+    std::remove(path);
+}
+
+// Hex built a bit at a time
+std::string naiveHex(const Poly& p) {
+    std::string res;
+    for (int d = p.size() == 0 ? 0 : p.degree() / 4; d >= 0; d--) {
+        int digit = 0;
+        for (int j = 3; j >= 0; j--) {
+            digit = 2 * digit + p.bit(4 * d + j);
+        }
+        res += "0123456789abcdef"[digit];
+    }
+    return res;
+}
+
+void bench_hex() {
+    std::default_random_engine generator;
+    generator.seed(getNanoseconds());
+
+    std::uniform_int_distribution<int> degreeDistrib(0, 5000);
+
+    // 1 - Check the hex of random polys and their parsing, with upper case
+    // and 0x, then that what isn't hex is rejected
+    {
+        int tries = 0;
+        int successes = 0;
+
+        for (int i = 0; i < 3000; i++) {
+            tries ++;
+
+            Poly p = Poly::random(degreeDistrib(generator), generator);
+            if (i == 0) {
+                p = Poly();
+            }
+            std::string hex = p.toHex();
+            std::string upper = "0X000" + hex;
+            for (char& c : upper) {
+                c = std::toupper(c);
+            }
+
+            Poly parsed;
+            bool ok = Poly::fromHex(upper.data(), upper.data() + upper.size(), parsed);
+            if (ok and hex == naiveHex(p) and hex.size() == p.hexSize() and
+                    (parsed + p).size() == 0 and parsed.degree() == p.degree()) {
+                successes ++;
+            }
+        }
+
+        const char* invalid[] = {"", "0x", "g", "12 3", "0x-1", "1234567890abcdef1234567890abcdeg", "\xff" "12"};
+        for (const char* text : invalid) {
+            tries ++;
+
+            Poly parsed = Poly::random(100, generator);
+            if (not Poly::fromHex(text, text + std::strlen(text), parsed) and parsed.size() == 0) {
+                successes ++;
+            }
+        }
+
+        std::cout << "Hex success ratio : (" << successes << "/" << tries << ")" << std::endl;
+    }
+
+    // 2 - Bench the printing and parsing of a poly of 32 MB of hex
+    {
+        Poly p = Poly::random(1 << 27, generator);
+        std::vector<char> buffer(p.hexSize());
+
+        auto start = std::chrono::high_resolution_clock::now();
+        p.toHex(buffer.data());
+        auto middle = std::chrono::high_resolution_clock::now();
+        Poly parsed;
+        Poly::fromHex(buffer.data(), buffer.data() + buffer.size(), parsed);
+        auto end = std::chrono::high_resolution_clock::now();
+
+        long printUs = std::chrono::duration_cast<std::chrono::microseconds>(middle - start).count();
+        long parseUs = std::chrono::duration_cast<std::chrono::microseconds>(end - middle).count();
+        std::cout << "Printing 32 MB of hex took " << printUs << " us (" << buffer.size() / std::max(1l, printUs) << " MB/s), parsing took "
+            << parseUs << " us (" << buffer.size() / std::max(1l, parseUs) << " MB/s)" << std::endl;
+
+        if ((parsed + p).size() != 0) {
+            std::cout << "Parsing the big poly failed" << std::endl;
+        }
+    }
+}
+
+SparsePoly randomSparse(unsigned weight, unsigned maxExponent, std::default_random_engine& generator) {
+    std::uniform_int_distribution<unsigned> distrib(0, maxExponent);
+    std::vector<SparsePoly::Exponent> exponents;
+    for (unsigned i = 0; i < weight; i++) {
+        exponents.push_back(distrib(generator));
+    }
+    return SparsePoly(exponents);
+}
+
+void bench_sparse() {
+    std::default_random_engine generator;
+    generator.seed(getNanoseconds());
+
+    std::uniform_int_distribution<unsigned> weightDistrib(0, 7);
+
+    std::vector<SparsePoly> moduli = {
+        {233, 74, 0},
+        {571, 10, 5, 2, 0},
+        {127, 126, 0},
+        {1, 0},
+    };
+
+    // 1 - Check the sparse arithmetic and the products with dense polys
+    // against the dense one, the random exponents collide now and then
+    {
+        int tries = 0;
+        int successes = 0;
+
+        for (int i = 0; i < 2000; i++) {
+            tries ++;
+
+            SparsePoly a = randomSparse(weightDistrib(generator), 30, generator);
+            SparsePoly b = randomSparse(weightDistrib(generator), 3000, generator);
+            Poly dense = Poly::random(i, generator);
+            Poly inPlace = dense;
+            b.multiply(inPlace, inPlace);
+
+            if (SparsePoly::fromPoly(b.toPoly()) == b and
+                ((a + b).toPoly() + a.toPoly() + b.toPoly()).size() == 0 and
+                ((a * b).toPoly() + a.toPoly() * b.toPoly()).size() == 0 and
+                ((b << 100).toPoly() + (b.toPoly() << 100)).size() == 0 and
+                (b.powerOfTwo(3).toPoly() + b.toPoly().square().square().square()).size() == 0 and
+                (b * dense + b.toPoly() * dense).size() == 0 and
+                (dense * b + inPlace).size() == 0) {
+                successes ++;
+            }
+        }
+
+        std::cout << "Sparse arithmetic success ratio : (" << successes << "/" << tries << ")" << std::endl;
+    }
+
+    // 2 - Check the reductions against the division and PolyModulus, up to
+    // exponents that no dense poly could hold
+    {
+        int tries = 0;
+        int successes = 0;
+
+        std::uniform_int_distribution<SparsePoly::Exponent> exponentDistrib;
+        for (const SparsePoly& f : moduli) {
+            Poly dense = f.toPoly();
+            PolyModulus modulus(dense);
+            Poly x = modulus.powmod(Poly::fromInt(2), 1);
+
+            for (int i = 0; i < 50; i++) {
+                tries ++;
+
+                Poly big = Poly::random(3 * f.degree() + i, generator);
+                Poly q, r;
+                big.euclidianDivision(dense, q, r);
+                f.reduce(big);
+
+                SparsePoly::Exponent e = exponentDistrib(generator) >> (i % 64);
+                SparsePoly s = SparsePoly({e, e >> 20, (SparsePoly::Exponent) i}) + SparsePoly::monomial(1).powerOfTwo(i);
+                Poly sReduced;
+                for (SparsePoly::Exponent term : s.exponents()) {
+                    sReduced += modulus.powmod(x, term);
+                }
+
+                if ((big + r).size() == 0 and
+                    (f.powerOfXMod(e) + modulus.powmod(x, e)).size() == 0 and
+                    (f.reduce(s) + sReduced).size() == 0) {
+                    successes ++;
+                }
+            }
+        }
+
+        std::cout << "Sparse reduction success ratio : (" << successes << "/" << tries << ")" << std::endl;
+    }
+
+    // 3 - Bench the products by the moduli and the reductions of products
+    // against the dense ones
+    for (const SparsePoly& f : moduli) {
+        if (f.degree() < 64) {
+            continue;
+        }
+
+        Poly dense = f.toPoly();
+        PolyModulus modulus(dense);
+        int iterations = 3000000 / f.degree();
+
+        Poly a = Poly::random(f.degree() - 1, generator);
+        Poly b = Poly::random(f.degree() - 1, generator);
+        Poly product = a * b;
+        Poly res, q;
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < iterations; i++) {
+            a.multiply(dense, res);
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        std::cout << "Degree " << f.degree() << " weight " << f.weight() << " dense multiply took " << std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / iterations << " ns" << std::endl;
+
+        start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < iterations; i++) {
+            f.multiply(a, res);
+        }
+        end = std::chrono::high_resolution_clock::now();
+        std::cout << "Degree " << f.degree() << " weight " << f.weight() << " sparse multiply took " << std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / iterations << " ns" << std::endl;
+
+        start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < iterations; i++) {
+            product.euclidianDivision(dense, q, res);
+        }
+        end = std::chrono::high_resolution_clock::now();
+        std::cout << "Degree " << f.degree() << " weight " << f.weight() << " division took " << std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / iterations << " ns" << std::endl;
+
+        start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < iterations; i++) {
+            res = product;
+            modulus.reduce(res);
+        }
+        end = std::chrono::high_resolution_clock::now();
+        std::cout << "Degree " << f.degree() << " weight " << f.weight() << " PolyModulus reduction took " << std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / iterations << " ns" << std::endl;
+
+        start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < iterations; i++) {
+            res = product;
+            f.reduce(res);
+        }
+        end = std::chrono::high_resolution_clock::now();
+        std::cout << "Degree " << f.degree() << " weight " << f.weight() << " sparse reduction took " << std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / iterations << " ns" << std::endl;
+    }
+
+    // 4 - Bench x^(2^60) modulo the pentanomial
+    {
+        const SparsePoly& f = moduli[1];
+        PolyModulus modulus(f.toPoly());
+        SparsePoly::Exponent e = ((SparsePoly::Exponent) 1) << 60;
+
+        auto start = std::chrono::high_resolution_clock::now();
+        Poly sparseRes = f.powerOfXMod(e);
+        auto end = std::chrono::high_resolution_clock::now();
+        std::cout << "Sparse x^(2^60) mod degree " << f.degree() << " took " << std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << " us" << std::endl;
+
+        start = std::chrono::high_resolution_clock::now();
+        Poly denseRes = modulus.powmod(Poly::fromInt(2), e);
+        end = std::chrono::high_resolution_clock::now();
+        std::cout << "PolyModulus x^(2^60) mod degree " << f.degree() << " took " << std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << " us" << std::endl;
+    }
+}
+
+void bench_square() {
+    std::default_random_engine generator;
+    generator.seed(getNanoseconds());
+
+    std::uniform_int_distribution<int> degreeDistrib(0, 8192);
+
+    // 1 - Check Correctness of the squaring
+    {
+        int tries = 0;
+        int successes = 0;
+
+        for (int i = 0; i < 1000; i++) {
+            tries ++;
+
+            Poly p = Poly::random(degreeDistrib(generator), generator);
+            Poly res1 = p * p;
+            Poly res2 = p.square();
+            Poly res3 = p;
+            res3.square(res3);
+
+            if ((res1 + res2).size() == 0 and (res1 + res3).size() == 0) {
+                successes ++;
+            }
+        }
+
+        std::cout << "Square success ratio : (" << successes << "/" << tries << ")" << std::endl;
+    }
+
+    // 2 - Bench the squaring against the multiplication
+    {
+        Poly p = Poly::random(1 << 16, generator);
+        Poly r;
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < 100; i++) {
+            p.multiply(p, r);
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+
+        std::cout << "Multiply degree 65536 took " << std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 100 << " us" << std::endl;
+
+        start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < 100; i++) {
+            p.square(r);
+        }
+        end = std::chrono::high_resolution_clock::now();
+
+        std::cout << "Square degree 65536 took " << std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 100 << " us" << std::endl;
+    }
+}
+
+template<unsigned Bits>
+void bench_fixed() {
+    std::default_random_engine generator;
+    generator.seed(getNanoseconds());
+
+    std::uniform_int_distribution<int> degreeDistrib(0, Bits - 1);
+
+    std::vector<Poly> polys;
+    std::vector<FixedPoly<Bits>> fixedPolys;
+
+    for (int i = 0;  i < 1000; i++) {
+        polys.push_back(Poly::random(degreeDistrib(generator), generator));
+        fixedPolys.push_back(FixedPoly<Bits>(polys.back()));
+    }
+
+    // 1 - Check Correctness of the fixed width operations against Poly
+    {
+        int tries = 0;
+        int successes = 0;
+
+        for (unsigned i = 0; i < polys.size(); i++) {
+            for (unsigned j = 0; j < polys.size(); j++) {
+                tries ++;
+
+                Poly res1 = polys[i] * polys[j];
+                Poly res2 = (fixedPolys[i] * fixedPolys[j]).toPoly();
+
+                int shift = j % Bits;
+                Poly res3 = FixedPoly<Bits>(polys[i] << shift).toPoly();
+                Poly res4 = (fixedPolys[i] << shift).toPoly();
+
+                Poly res5 = polys[i] >> shift;
+                Poly res6 = (fixedPolys[i] >> shift).toPoly();
+
+                if ((res1 + res2).size() == 0 and (res3 + res4).size() == 0 and (res5 + res6).size() == 0) {
+                    successes ++;
+                }
+            }
+        }
+
+        std::cout << "FixedPoly<" << Bits << "> success ratio : (" << successes << "/" << tries << ")" << std::endl;
+    }
+
+    // 2 - Bench the fixed width multiplication
+    {
+        int forceBench = 0;
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (const FixedPoly<Bits>& p : fixedPolys) {
+            for (const FixedPoly<Bits>& q : fixedPolys) {
+                forceBench += (p * q).block(0);
+            }
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+
+        volatile int forceBench2 = forceBench;
+        (void) forceBench2;
+
+        std::cout << "FixedPoly<" << Bits << "> multiply took " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms" << std::endl;
+    }
+}
+
+// Dumps the counters of a few typical operations, when compiled in
+void bench_stats() {
+    if (not PolyStats::enabled) {
+        std::cout << "Instrumentation disabled, build with POLY_INSTRUMENTATION=ON for the stats" << std::endl;
+        return;
+    }
+
+    std::default_random_engine generator;
+    generator.seed(getNanoseconds());
+
+    Poly a = Poly::random(1 << 16, generator);
+    Poly b = Poly::random(1 << 15, generator);
+    Poly q, r;
+
+    PolyStats& stats = PolyStats::forThisThread();
+    stats.reset();
+    Poly product = a * b;
+    product.euclidianDivision(b, q, r);
+    Poly g = a.gcd(b);
+
+    std::cout << "Stats of a product, a division and a gcd of degree 65536 :" << std::endl;
+    stats.dump(std::cout);
+}
+
 int main(){
+    bench_kernels();
     bench_multiply();
     bench_shifts();
+    bench_block_kernels();
     bench_division();
+    bench_big();
+    bench_algorithms();
+    bench_big_division();
+    bench_parallel_multiply();
+    bench_modulus();
+    bench_gcd();
+    bench_factor();
+    bench_irreducible();
+    bench_corpus();
+    bench_hex();
+    bench_sparse();
+    bench_square();
+    bench_fixed<64>();
+    bench_fixed<192>();
+    bench_fixed<256>();
+    bench_stats();
 }
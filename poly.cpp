@@ -1,32 +1,139 @@
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <cmath>
+#include <cstring>
 #include <random>
+#include <vector>
 
 #include "poly.h"
 #include "bit_utils.h"
+#include "poly_stats.h"
+#include "thread_pool.h"
 #include "utils.h"
+#include "workspace.h"
+
+// Debug builds check the degree against the blocks after each operation
+#ifndef POLY_CHECK_INVARIANTS
+    #define POLY_CHECK_INVARIANTS 0
+#endif
+
+// Measured on a CLMUL machine, the FFT wins from about a million bits
+Poly::MultiplyThresholds Poly::multiplyThresholds = {8, 96, 1 << 14};
+const Poly::MultiplyThresholds Poly::KARATSUBA_ONLY = {2, UINT_MAX, UINT_MAX};
+// Newton iteration gets ahead of the block division at about 24k bits
+unsigned Poly::newtonDivisionThreshold = 384;
+// Below that the products are too quick for the cost of the tasks to pay off
+unsigned Poly::parallelMultiplyThreshold = 512;
 
 /*****************************************************************************\
 |*                                Constructors                               *|
 \*****************************************************************************/ 
 
 Poly::Poly() {
+    POLY_COUNT(TEMPORARIES);
     for (unsigned i = 0; i < NUM_INLINE_BLOCKS; i++) {
         this->inlineBlocks[i] = 0;
     }
     this->deg = -1;
 }
 
-Poly::Poly(unsigned) {
-
+Poly::Poly(unsigned numBlocks) {
+    POLY_COUNT(TEMPORARIES);
     for (unsigned i = 0; i < NUM_INLINE_BLOCKS; i++) {
         this->inlineBlocks[i] = 0;
     }
+
+    if (numBlocks > NUM_INLINE_BLOCKS) {
+        POLY_COUNT(HEAP_ALLOCATIONS);
+        this->heapBlocks = new Block[numBlocks]();
+        this->capacity = numBlocks;
+    }
     this->deg = -1;
 }
 
+Poly::Poly(const Poly& other) {
+    POLY_COUNT(TEMPORARIES);
+    if (other.heapBlocks != nullptr) {
+        POLY_COUNT(HEAP_ALLOCATIONS);
+        this->heapBlocks = new Block[other.capacity];
+        this->capacity = other.capacity;
+        std::memcpy(this->heapBlocks, other.heapBlocks, this->capacity * sizeof(Block));
+    } else {
+        std::memcpy(this->inlineBlocks, other.inlineBlocks, sizeof(inlineBlocks));
+    }
+    this->deg = other.deg;
+}
+
+// Moving a spilled poly only steals the heap pointer, inline ones are copied
+Poly::Poly(Poly&& other) {
+    POLY_COUNT(TEMPORARIES);
+    if (other.heapBlocks != nullptr) {
+        this->heapBlocks = other.heapBlocks;
+        this->capacity = other.capacity;
+        other.heapBlocks = nullptr;
+        other.capacity = NUM_INLINE_BLOCKS;
+    } else {
+        std::memcpy(this->inlineBlocks, other.inlineBlocks, sizeof(inlineBlocks));
+    }
+    // other is left as 0
+    std::memset(other.inlineBlocks, 0, sizeof(other.inlineBlocks));
+    this->deg = other.deg;
+    other.deg = -1;
+}
+
+Poly& Poly::operator=(const Poly& other) {
+    if (this == &other) {
+        return *this;
+    }
+
+    if (this->heapBlocks == nullptr and other.heapBlocks == nullptr) {
+        std::memcpy(this->inlineBlocks, other.inlineBlocks, sizeof(inlineBlocks));
+        this->deg = other.deg;
+        return *this;
+    }
+
+    // Keep our buffer if it is big enough, the extra blocks are zeroed
+    if (this->capacity < other.capacity) {
+        POLY_COUNT(HEAP_ALLOCATIONS);
+        delete[] this->heapBlocks;
+        this->heapBlocks = new Block[other.capacity];
+        this->capacity = other.capacity;
+    }
+
+    std::memcpy(this->data(), other.data(), other.capacity * sizeof(Block));
+    std::memset(this->data() + other.capacity, 0, (this->capacity - other.capacity) * sizeof(Block));
+    this->deg = other.deg;
+
+    return *this;
+}
+
+Poly& Poly::operator=(Poly&& other) {
+    if (this == &other) {
+        return *this;
+    }
+
+    // other gets our value, the inline blocks go along for when it is there
+    if (other.heapBlocks != nullptr) {
+        std::swap(this->heapBlocks, other.heapBlocks);
+        std::swap(this->capacity, other.capacity);
+        std::swap(this->inlineBlocks, other.inlineBlocks);
+        std::swap(this->deg, other.deg);
+        return *this;
+    }
+
+    delete[] this->heapBlocks;
+    this->heapBlocks = nullptr;
+    this->capacity = NUM_INLINE_BLOCKS;
+    std::memcpy(this->inlineBlocks, other.inlineBlocks, sizeof(inlineBlocks));
+    this->deg = other.deg;
+
+    return *this;
+}
+
 Poly Poly::fromInt(Block value) {
     Poly res;
-    res.setBlock(0, value);
-    res.computeDegree();
+    res.setToBlock(value);
     return res;
 }
 
@@ -37,14 +144,9 @@ Poly Poly::random(unsigned len) {
     return Poly::random(len, generator);
 }
 
-//TODO: check bounds
-Poly Poly::fromBlocks(Poly origin, unsigned start, unsigned end) {
+Poly Poly::fromBlocks(const Poly& origin, unsigned start, unsigned end) {
     Poly res(end - start);
-
-    for(unsigned i = start; i < end; i++) {
-        res.setBlock(i - start, origin.block(i));
-    }
-
+    origin.blocks(start, end, res);
     return res;
 }
 
@@ -56,8 +158,13 @@ Poly::Bit Poly::bit(unsigned i) const {
     return ((this->block(i / BLOCK_SIZE)) >> (i % BLOCK_SIZE)) & 1;
 }
 
+// Blocks past the end of the storage read as 0 so that operands of
+// different capacities can be mixed freely
 Poly::Block Poly::block(unsigned i) const {
-    return this->inlineBlocks[i];
+    if (i >= this->capacity) {
+        return 0;
+    }
+    return this->data()[i];
 }
 
 int Poly::degree() const {
@@ -69,28 +176,61 @@ unsigned Poly::size() const {
 }
 
 unsigned Poly::numBlocks() const {
-    return NUM_INLINE_BLOCKS;
+    return this->capacity;
 }
 
 unsigned Poly::numUsedBlocks() const {
     return (this->size() + (BLOCK_SIZE - 1)) / BLOCK_SIZE;
 }
 
-/*****************************************************************************\
-|*                                 Operators                                 *|
-\*****************************************************************************/ 
+// The block kernels are called through a pointer, which costs more than it
+// saves on the few blocks of the small polys, these are done inline.
+static const unsigned SMALL_KERNEL_BLOCKS = 4;
 
-Poly Poly::operator+(const Poly& other) const {
-    unsigned nBlocks = std::max(this->numUsedBlocks(), other.numUsedBlocks());
-    Poly p(nBlocks);
+static inline void xorBlockArrays(const Poly::Block* a, const Poly::Block* b, unsigned n, Poly::Block* dst) {
+    if (n > SMALL_KERNEL_BLOCKS) {
+        fast_xor_blocks(a, b, n, dst);
+        return;
+    }
+    for (unsigned i = 0; i < n; i++) {
+        dst[i] = a[i] ^ b[i];
+    }
+}
 
-    for (unsigned i = 0; i < nBlocks; i++) {
-        p.setBlock(i, this->block(i) ^ other.block(i));
+static inline void shiftLeftBlocks(const Poly::Block* src, unsigned n, unsigned shift, Poly::Block* dst) {
+    if (n > SMALL_KERNEL_BLOCKS) {
+        fast_shift_left_blocks(src, n, shift, dst);
+        return;
+    }
+    for (unsigned i = n; i > 1; i--) {
+        dst[i - 1] = (src[i - 1] << shift) | (src[i - 2] >> (Poly::BLOCK_SIZE - shift));
+    }
+    if (n != 0) {
+        dst[0] = src[0] << shift;
+    }
+}
+
+static inline void shiftRightBlocks(const Poly::Block* src, unsigned n, unsigned shift, Poly::Block* dst) {
+    if (n > SMALL_KERNEL_BLOCKS) {
+        fast_shift_right_blocks(src, n, shift, dst);
+        return;
     }
+    for (unsigned i = 0; i + 1 < n; i++) {
+        dst[i] = (src[i] >> shift) | (src[i + 1] << (Poly::BLOCK_SIZE - shift));
+    }
+    if (n != 0) {
+        dst[n - 1] = src[n - 1] >> shift;
+    }
+}
 
-    p.computeDegree();
+/*****************************************************************************\
+|*                                 Operators                                 *|
+\*****************************************************************************/ 
 
-    return p;
+Poly Poly::operator+(const Poly& other) const {
+    Poly res;
+    this->add(other, res);
+    return res;
 }
 
 Poly Poly::operator-(const Poly& other) const {
@@ -98,123 +238,261 @@ Poly Poly::operator-(const Poly& other) const {
 }
 
 Poly Poly::operator*(const Poly& other) const {
-    return this->multiplyKaratsuba32(other);
+    Poly res;
+    this->multiply(other, res);
+    return res;
 }
 
 Poly Poly::operator&(const Poly& other) const {
-    unsigned nBlocks = (std::max(this->size(), other.size()) + (BLOCK_SIZE - 1)) / BLOCK_SIZE;
+    unsigned nBlocks = std::min(this->numUsedBlocks(), other.numUsedBlocks());
     Poly p(nBlocks);
 
-    for (unsigned i = 0; i < nBlocks; i++) {
-        p.setBlock(i, this->block(i) & other.block(i));
-    }
+    fast_and_blocks(this->data(), other.data(), nBlocks, p.data());
+
+    p.computeDegreeFrom(nBlocks);
 
     return p;
 }
 
 Poly Poly::operator|(const Poly& other) const {
-    unsigned nBlocks = (std::max(this->size(), other.size()) + (BLOCK_SIZE - 1)) / BLOCK_SIZE;
+    const Poly& longer = this->numUsedBlocks() >= other.numUsedBlocks() ? *this : other;
+    const Poly& shorter = &longer == this ? other : *this;
+    unsigned nBlocks = longer.numUsedBlocks();
+    unsigned nCommon = shorter.numUsedBlocks();
     Poly p(nBlocks);
 
-    for (unsigned i = 0; i < nBlocks; i++) {
-        p.setBlock(i, this->block(i) | other.block(i));
-    }
+    fast_or_blocks(longer.data(), shorter.data(), nCommon, p.data());
+    std::copy(longer.data() + nCommon, longer.data() + nBlocks, p.data() + nCommon);
+
+    p.finishBlocks(nBlocks, 0, std::max(this->degree(), other.degree()));
 
     return p;
 }
 
 Poly Poly::operator^(const Poly& other) const {
-    unsigned nBlocks = (std::max(this->size(), other.size()) + (BLOCK_SIZE - 1)) / BLOCK_SIZE;
-    Poly p(nBlocks);
+    return *this + other;
+}
 
-    for (unsigned i = 0; i < nBlocks; i++) {
-        p.setBlock(i, this->block(i) ^ other.block(i));
-    }
+Poly Poly::operator<<(int i) const {
+    Poly res;
+    this->shiftLeft(i, res);
+    return res;
+}
 
-    return p;
+Poly Poly::operator>>(int i) const {
+    Poly res;
+    this->shiftRight(i, res);
+    return res;
 }
 
-Poly Poly::operator<<(int i) const {
-    int iMod = i % BLOCK_SIZE;
+Poly Poly::square() const {
+    Poly res;
+    this->square(res);
+    return res;
+}
 
-    // Handle this case separetaly because shifting by more (or equal) than the block size is an undefined op
-    // We just shift by blocks
-    if (iMod == 0) {
-        Poly res = this->leftBlockShifted(i / BLOCK_SIZE);
-        res.deg = this->degree() + i;
-        return res;
-    }
+Poly& Poly::operator+=(const Poly& other) {
+    this->add(other, *this);
+    return *this;
+}
+
+Poly& Poly::operator-=(const Poly& other) {
+    this->add(other, *this);
+    return *this;
+}
 
-    int resNBlocks = (this->size() + i + BLOCK_SIZE - 1) / BLOCK_SIZE;
-    Poly res(resNBlocks);
+Poly& Poly::operator*=(const Poly& other) {
+    this->multiply(other, *this);
+    return *this;
+}
 
-    int thisIndex = 0;
-    int resIndex = i / BLOCK_SIZE;
+Poly& Poly::operator<<=(int i) {
+    this->shiftLeft(i, *this);
+    return *this;
+}
 
-    Block shiftedLow = this->block(thisIndex) << iMod;
-    res.setBlock(resIndex, shiftedLow);
-    resIndex ++;
+Poly& Poly::operator>>=(int i) {
+    this->shiftRight(i, *this);
+    return *this;
+}
 
-    Block nextHigh = this->block(thisIndex) >> (BLOCK_SIZE - iMod);
+/*****************************************************************************\
+|*                       Destination parameter operations                    *|
+\*****************************************************************************/ 
 
-    // For each block of res we gather
-    //  - The high part of the previous block of this
-    //  - The low part of the current block of this
-    // We don't need the high part of the last block of this because it is always 0
-    while(resIndex < resNBlocks) {
-        thisIndex ++;
-        res.setBlock(resIndex, res.block(resIndex) | nextHigh);
+// All of these write their result in res, reusing its storage when it is big
+// enough. res may be the same object as one of the operands.
+
+void Poly::add(const Poly& other, Poly& res) const {
+    const Poly& longer = this->numUsedBlocks() >= other.numUsedBlocks() ? *this : other;
+    const Poly& shorter = &longer == this ? other : *this;
+    unsigned nBlocks = longer.numUsedBlocks();
+    unsigned nCommon = shorter.numUsedBlocks();
+    int thisDegree = this->degree();
+    int otherDegree = other.degree();
+    unsigned previousUsed = res.prepareBlocks(nBlocks);
+
+    // The pointers are taken after prepareBlocks, which can move the blocks of res
+    xorBlockArrays(longer.data(), shorter.data(), nCommon, res.data());
+    if (&res != &longer) {
+        std::copy(longer.data() + nCommon, longer.data() + nBlocks, res.data() + nCommon);
+    }
 
-        shiftedLow = this->block(thisIndex) << iMod;
-        nextHigh = this->block(thisIndex) >> (BLOCK_SIZE - iMod);
+    // Unless the leading terms cancel the degree is the bigger one
+    if (thisDegree != otherDegree) {
+        res.finishBlocks(nBlocks, previousUsed, std::max(thisDegree, otherDegree));
+    } else {
+        res.finishBlocks(nBlocks, previousUsed);
+    }
+}
 
-        res.setBlock(resIndex, res.block(resIndex) | shiftedLow);
+void Poly::multiply(const Poly& other, Poly& res) const {
+    this->multiply(other, res, multiplyThresholds);
+}
 
-        resIndex ++;
+void Poly::multiply(const Poly& other, Poly& res, const MultiplyThresholds& thresholds) const {
+    // The algorithms read the operands while writing the result, use a temporary
+    if (&res == this or &res == &other) {
+        Poly temp;
+        this->doMultiply(other, temp, thresholds);
+        res = std::move(temp);
+        return;
     }
 
-    res.deg = this->degree() + i;
-    return res;
+    this->doMultiply(other, res, thresholds);
 }
 
-Poly Poly::operator>>(int i) const {
-    // Same ideas as operator<<
-    int iMod = i % BLOCK_SIZE;
+// The operands go through the kernel by chunks of 256, a multiple of the
+// bitsliced batches, which fit on the stack. The blocks are read and written
+// in place, a Poly always has at least NUM_INLINE_BLOCKS of them.
+void Poly::multiplyBatch(const std::vector<Poly>& a, const std::vector<Poly>& b, std::vector<Poly>& res) {
+    assert(a.size() == b.size());
+    const unsigned CHUNK = 256;
+    Block aBlocks[CHUNK], bBlocks[CHUNK], high[CHUNK], low[CHUNK];
+
+    unsigned n = std::min(a.size(), b.size());
+    res.resize(n);
+    for (unsigned start = 0; start < n; start += CHUNK) {
+        unsigned count = std::min(CHUNK, n - start);
+        const Poly* aPolys = a.data() + start;
+        const Poly* bPolys = b.data() + start;
+        for (unsigned i = 0; i < count; i++) {
+            aBlocks[i] = aPolys[i].data()[0];
+            bBlocks[i] = bPolys[i].data()[0];
+        }
 
-    if (iMod == 0) {
-        Poly res = this->rightBlockShifted(i / BLOCK_SIZE);
-        res.deg = this->degree() - i;
-        return res;
+        fast_convolution_64_128_batch(aBlocks, bBlocks, count, high, low);
+
+        for (unsigned i = 0; i < count; i++) {
+            Poly& product = res[start + i];
+            // The operands that don't fit in a block take the general path
+            if (aPolys[i].deg >= (int) BLOCK_SIZE or bPolys[i].deg >= (int) BLOCK_SIZE) {
+                aPolys[i].multiply(bPolys[i], product);
+                continue;
+            }
+
+            bool zero = aPolys[i].deg < 0 or bPolys[i].deg < 0;
+            unsigned previousUsed = product.prepareBlocks(2);
+            Block* blocks = product.data();
+            blocks[0] = low[i];
+            blocks[1] = high[i];
+            product.finishBlocks(2, previousUsed, zero ? -1 : aPolys[i].deg + bPolys[i].deg);
+        }
     }
+}
 
-    int resNBlocks = (this->size() + i + BLOCK_SIZE - 1) / BLOCK_SIZE;
-    Poly res(resNBlocks);
+void Poly::square(Poly& res) const {
+    unsigned nBlocks = this->numUsedBlocks();
+    unsigned previousUsed = res.prepareBlocks(2 * nBlocks);
+    Block* resBlocks = res.data();
+    const Block* thisBlocks = this->data();
+
+    // Block i gives blocks 2i and 2i + 1, going down lets res be this
+    for (unsigned i = nBlocks; i-->0;) {
+        Block high, low;
+        fast_square_64_128(thisBlocks[i], high, low);
+        resBlocks[2 * i + 1] = high;
+        resBlocks[2 * i] = low;
+    }
 
-    int nBlocks = this->numBlocks();
+    res.finishBlocks(2 * nBlocks, previousUsed, this->size() == 0 ? -1 : 2 * this->degree());
+}
 
-    int resIndex = 0;
-    int thisIndex = i / BLOCK_SIZE;
+void Poly::shiftLeft(int i, Poly& res) const {
+    if (this->size() == 0) {
+        res.setToBlock(0);
+        return;
+    }
 
-    Block nextHigh = this->block(thisIndex) >> iMod;
+    int iMod = i % BLOCK_SIZE;
+    unsigned blockShift = i / BLOCK_SIZE;
+    unsigned nBlocks = this->numUsedBlocks();
+    unsigned resNBlocks = (this->size() + i + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    int degree = this->degree() + i;
+    unsigned previousUsed = res.prepareBlocks(resNBlocks);
+    const Block* src = this->data();
+    Block* dst = res.data() + blockShift;
+
+    // We go from the top block down so that res can be this.
+    // Handle iMod == 0 separetaly because shifting by more (or equal) than the block size is an undefined op
+    // We just move the blocks
+    if (iMod == 0) {
+        std::memmove(dst, src, nBlocks * sizeof(Block));
+    } else {
+        // For each block of res the kernel gathers
+        //  - The high part of the previous block of this
+        //  - The low part of the current block of this
+        // The top block of res, if any, only has the high part of the top block of this
+        if (resNBlocks - blockShift > nBlocks) {
+            dst[nBlocks] = src[nBlocks - 1] >> (BLOCK_SIZE - iMod);
+        }
+        shiftLeftBlocks(src, nBlocks, iMod, dst);
+    }
 
-    thisIndex ++;
+    std::fill(res.data(), dst, 0);
 
-    while(thisIndex < nBlocks) {
-        res.setBlock(resIndex, res.block(resIndex) | nextHigh);
+    res.finishBlocks(resNBlocks, previousUsed, degree);
+}
 
-        Block shiftedLow = this->block(thisIndex) << (BLOCK_SIZE - iMod);
-        nextHigh = this->block(thisIndex) >> iMod;
+void Poly::shiftRight(int i, Poly& res) const {
+    if ((int) this->size() <= i) {
+        res.setToBlock(0);
+        return;
+    }
 
-        res.setBlock(resIndex, res.block(resIndex) | shiftedLow);
+    // Same ideas as shiftLeft, but we go from the bottom block up
+    int iMod = i % BLOCK_SIZE;
+    unsigned blockShift = i / BLOCK_SIZE;
+    unsigned resNBlocks = (this->size() - i + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    unsigned available = this->numUsedBlocks() - blockShift;
+    int degree = this->degree() - i;
+    unsigned previousUsed = res.prepareBlocks(resNBlocks);
+    const Block* src = this->data() + blockShift;
+    Block* dst = res.data();
 
-        resIndex ++;
-        thisIndex ++;
+    if (iMod == 0) {
+        std::memmove(dst, src, resNBlocks * sizeof(Block));
+    } else {
+        shiftRightBlocks(src, resNBlocks, iMod, dst);
+        // The block of this after the ones the kernel read can still have low bits for res
+        if (available > resNBlocks) {
+            dst[resNBlocks - 1] |= src[resNBlocks] << (BLOCK_SIZE - iMod);
+        }
     }
 
-    res.setBlock(resIndex, res.block(resIndex) | nextHigh);
+    res.finishBlocks(resNBlocks, previousUsed, degree);
+}
+
+//TODO: check bounds
+void Poly::blocks(unsigned start, unsigned end, Poly& res) const {
+    unsigned nBlocks = end - start;
+    unsigned previousUsed = res.prepareBlocks(nBlocks);
 
-    res.deg = this->degree() - i;
-    return res;
+    for (unsigned i = start; i < end; i++) {
+        res.setBlock(i - start, this->block(i));
+    }
+
+    res.finishBlocks(nBlocks, previousUsed);
 }
 
 /*****************************************************************************\
@@ -222,83 +500,89 @@ Poly Poly::operator>>(int i) const {
 \*****************************************************************************/ 
 
 int Poly::computeDegree() {
-    for (unsigned i = this->numBlocks(); i-->0;) {
-        Block b = this->block(i);
-        if (b != 0) {
-            //TODO remove the assumption on the block size
-            deg = i * BLOCK_SIZE + log2_u64(b);
-            return deg;
-        }
-    }
-
-    //We have the 0 polynomial.
-    deg = -1;
-    return deg;
+    return this->computeDegreeFrom(this->numBlocks());
 }
 
-Poly Poly::leftBlockShifted(unsigned i) const {
-    unsigned nBlocks = this->numUsedBlocks();
-    Poly res(nBlocks + i);
+// Over GF(2) x^i derives to x^(i-1) for i odd and to 0 for i even
+Poly Poly::derivative() const {
+    static const Block EVEN_BITS = 0x5555555555555555ull;
 
-    for (unsigned j = 0; j < nBlocks; j++) {
-        res.setBlock(i + j, this->block(j));
+    unsigned nBlocks = this->numUsedBlocks();
+    Poly res(nBlocks);
+    for (unsigned i = 0; i < nBlocks; i++) {
+        res.setBlock(i, (this->block(i) >> 1) & EVEN_BITS);
     }
-
+    res.computeDegreeFrom(nBlocks);
     return res;
 }
 
-Poly Poly::rightBlockShifted(unsigned i) const {
-    int nBlocks = this->numUsedBlocks();
-    Poly res(nBlocks - i);
-
-    for (int j = i; j < nBlocks; j++) {
-        res.setBlock(j - i, this->block(j));
+// The inverse of square(), the odd coefficients are ignored
+Poly Poly::squareRoot() const {
+    unsigned nBlocks = (this->numUsedBlocks() + 1) / 2;
+    Poly res(nBlocks);
+    for (unsigned i = 0; i < nBlocks; i++) {
+        Block low = even_bits_64_32(this->block(2 * i));
+        Block high = even_bits_64_32(this->block(2 * i + 1));
+        res.setBlock(i, low | (high << (BLOCK_SIZE / 2)));
     }
-
+    res.computeDegreeFrom(nBlocks);
     return res;
 }
 
+Poly Poly::leftBlockShifted(unsigned i) const {
+    return *this << (i * BLOCK_SIZE);
+}
+
+Poly Poly::rightBlockShifted(unsigned i) const {
+    return *this >> (i * BLOCK_SIZE);
+}
+
 Poly Poly::multiplyNaively(const Poly& other) const {
-    Poly res;
+    Poly res(this->numUsedBlocks() + other.numUsedBlocks());
     for (unsigned i = 0; i < this->size(); i++) {
         for (unsigned j = 0; j < other.size(); j++) {
             res.xorBit(i + j, this->bit(i) & other.bit(j));            
         }
     }
 
-    res.computeDegree();
+    res.computeDegreeFrom(this->numUsedBlocks() + other.numUsedBlocks());
 
     return res;
 }
 
 Poly Poly::multiplyKaratsuba8(const Poly& other) const {
-    return this->doMultiplyKaratsuba(other, 8);
+    Poly res;
+    this->doMultiply(other, res, KARATSUBA_ONLY);
+    return res;
 }
 
 Poly Poly::multiplyKaratsuba16(const Poly& other) const {
-    return this->doMultiplyKaratsuba(other, 16);
+    Poly res;
+    this->doMultiply(other, res, KARATSUBA_ONLY);
+    return res;
 }
 
 Poly Poly::multiplyKaratsuba32(const Poly& other) const {
-    return this->doMultiplyKaratsuba(other, 32);
+    Poly res;
+    this->doMultiply(other, res, KARATSUBA_ONLY);
+    return res;
 }
 
+// q and r must not be this or b, b must not be 0
 void Poly::euclidianDivision(const Poly& b, Poly& q, Poly& r) const {
-    r = *this;
-    q = Poly(this->degree() - b.size() + 1);
-
+    POLY_TIME(DIVISION_TIME);
     if (this->size() < b.size()) {
+        r = *this;
+        q.setToBlock(0);
         return;
     }
 
-    Poly bShifted = b << (this->size() - b.size());
-
-    while (r.degree() >= b.degree()) {
-        bShifted = bShifted >> (bShifted.size() - r.size());
-        q.setBit(bShifted.size() - b.size(), 1);
-        r = r + bShifted;
+    unsigned qNBlocks = (this->degree() - b.degree()) / BLOCK_SIZE + 1;
+    if (std::min(qNBlocks, b.numUsedBlocks()) >= newtonDivisionThreshold) {
+        this->doDivideNewton(b, q, r);
+    } else {
+        this->doDivideBlocks(b, q, r);
     }
-    q.computeDegree();
 }
 
 /*****************************************************************************\
@@ -306,7 +590,87 @@ void Poly::euclidianDivision(const Poly& b, Poly& q, Poly& r) const {
 \*****************************************************************************/ 
 
 void Poly::setBlock(unsigned i, Block value) {
-    this->inlineBlocks[i] = value;
+    this->data()[i] = value;
+}
+
+void Poly::setToBlock(Block value) {
+    unsigned previousUsed = this->prepareBlocks(1);
+    this->setBlock(0, value);
+    this->finishBlocks(1, previousUsed, value == 0 ? -1 : log2_u64(value));
+}
+
+// Grows the storage to at least nBlocks, keeping the content
+void Poly::reserve(unsigned nBlocks) {
+    if (nBlocks <= this->capacity) {
+        return;
+    }
+
+    POLY_COUNT(HEAP_ALLOCATIONS);
+    Block* newBlocks = new Block[nBlocks]();
+    std::memcpy(newBlocks, this->data(), this->capacity * sizeof(Block));
+
+    delete[] this->heapBlocks;
+    this->heapBlocks = newBlocks;
+    this->capacity = nBlocks;
+}
+
+// To write a result of nBlocks blocks in place: prepareBlocks makes room for
+// them, then all of the nBlocks are written, then finishBlocks clears what
+// remains of the previous value and computes the degree.
+unsigned Poly::prepareBlocks(unsigned nBlocks) {
+    unsigned previousUsed = this->numUsedBlocks();
+    this->reserve(nBlocks);
+    return previousUsed;
+}
+
+void Poly::finishBlocks(unsigned nBlocks, unsigned previousUsed) {
+    for (unsigned i = nBlocks; i < previousUsed; i++) {
+        this->setBlock(i, 0);
+    }
+    this->computeDegreeFrom(nBlocks);
+}
+
+// When the degree of the result is known, as for shifts and products, it is
+// set directly instead of being scanned for
+void Poly::finishBlocks(unsigned nBlocks, unsigned previousUsed, int degree) {
+    for (unsigned i = nBlocks; i < previousUsed; i++) {
+        this->setBlock(i, 0);
+    }
+    this->deg = degree;
+    this->checkInvariants();
+}
+
+// Only looks at the first nBlocks, the ones above must be 0
+int Poly::computeDegreeFrom(unsigned nBlocks) {
+    POLY_COUNT(DEGREE_SCANS);
+    deg = -1;
+    for (unsigned i = std::min(nBlocks, this->numBlocks()); i-->0;) {
+        POLY_COUNT(DEGREE_SCANNED_BLOCKS);
+        Block b = this->block(i);
+        if (b != 0) {
+            //TODO remove the assumption on the block size
+            deg = i * BLOCK_SIZE + log2_u64(b);
+            break;
+        }
+    }
+
+    this->checkInvariants();
+    return deg;
+}
+
+// deg must be the degree of the blocks, all the blocks above it being 0.
+// This reads the whole storage so it is only done in debug builds.
+void Poly::checkInvariants() const {
+#if POLY_CHECK_INVARIANTS
+    int expected = -1;
+    for (unsigned i = this->capacity; i-->0;) {
+        if (this->data()[i] != 0) {
+            expected = i * BLOCK_SIZE + log2_u64(this->data()[i]);
+            break;
+        }
+    }
+    assert(expected == this->deg);
+#endif
 }
 
 void Poly::setBit(unsigned i, Bit value) {
@@ -315,186 +679,950 @@ void Poly::setBit(unsigned i, Bit value) {
     //Note that it is free, simply changing the shll to shlq mnemonics.
     Block valueBlock = value;
 
-    this->inlineBlocks[i / BLOCK_SIZE] &= ~(((uint64_t)1) << i);
-    this->inlineBlocks[i / BLOCK_SIZE] |= (valueBlock << i);
+    this->data()[i / BLOCK_SIZE] &= ~(((uint64_t)1) << (i % BLOCK_SIZE));
+    this->data()[i / BLOCK_SIZE] |= (valueBlock << (i % BLOCK_SIZE));
 }
 
 void Poly::xorBit(unsigned i, Bit value) {
     Block valueBlock = value;
-    this->inlineBlocks[i / BLOCK_SIZE] ^= (valueBlock << i);
+    this->data()[i / BLOCK_SIZE] ^= (valueBlock << (i % BLOCK_SIZE));
 }
 
 /*****************************************************************************\
-|*                         Karatsuba implementation                          *|
-\*****************************************************************************/ 
+|*                       Block level helpers                                 *|
+\*****************************************************************************/
 
-Poly Poly::doMultiplyKaratsuba(const Poly& other, unsigned splitLimit) const {
+// dst[0, n) ^= src[0, n)
+static void xorBlocks(Poly::Block* dst, const Poly::Block* src, unsigned n) {
+    xorBlockArrays(dst, src, n, dst);
+}
+
+// dst[0, dstLen) ^= src[0, srcLen) << shift, the bits going past dstLen are
+// dropped. Each block of the result is gathered from two neighbouring blocks
+// of src so the loop has no branch and vectorizes. dst must not overlap src.
+static void xorShiftedLeft(Poly::Block* dst, unsigned dstLen, const Poly::Block* src, unsigned srcLen, unsigned shift) {
+    unsigned blockShift = shift / Poly::BLOCK_SIZE;
+    unsigned bitShift = shift % Poly::BLOCK_SIZE;
+    if (blockShift >= dstLen or srcLen == 0) {
+        return;
+    }
+
+    dst += blockShift;
+    dstLen -= blockShift;
+    unsigned n = std::min(srcLen, dstLen);
+
+    // Shifting by the block size is undefined
+    if (bitShift == 0) {
+        xorBlocks(dst, src, n);
+        return;
+    }
+
+    dst[0] ^= src[0] << bitShift;
+    for (unsigned i = 1; i < n; i++) {
+        dst[i] ^= (src[i] << bitShift) | (src[i - 1] >> (Poly::BLOCK_SIZE - bitShift));
+    }
+    if (n < dstLen) {
+        dst[n] ^= src[n - 1] >> (Poly::BLOCK_SIZE - bitShift);
+    }
+}
+
+// dst[0, dstLen) ^= src[0, srcLen) >> shift, same as xorShiftedLeft
+static void xorShiftedRight(Poly::Block* dst, unsigned dstLen, const Poly::Block* src, unsigned srcLen, unsigned shift) {
+    unsigned blockShift = shift / Poly::BLOCK_SIZE;
+    unsigned bitShift = shift % Poly::BLOCK_SIZE;
+    if (blockShift >= srcLen or dstLen == 0) {
+        return;
+    }
+
+    src += blockShift;
+    srcLen -= blockShift;
+    unsigned n = std::min(srcLen, dstLen);
+
+    if (bitShift == 0) {
+        xorBlocks(dst, src, n);
+        return;
+    }
+
+    for (unsigned j = 0; j + 1 < n; j++) {
+        dst[j] ^= (src[j] >> bitShift) | (src[j + 1] << (Poly::BLOCK_SIZE - bitShift));
+    }
+    Poly::Block last = src[n - 1] >> bitShift;
+    if (n < srcLen) {
+        last |= src[n] << (Poly::BLOCK_SIZE - bitShift);
+    }
+    dst[n - 1] ^= last;
+}
+
+// Divides p[0, n) by x in place, p must be divisible by x
+static void divideByX(Poly::Block* p, unsigned n) {
+    for (unsigned i = 0; i + 1 < n; i++) {
+        p[i] = (p[i] >> 1) | (p[i + 1] << (Poly::BLOCK_SIZE - 1));
+    }
+    p[n - 1] >>= 1;
+}
+
+// Divides p[0, n) by x + 1 in place, p must be divisible by x + 1.
+// The quotient q verifies q_i = p_i + q_(i-1) so it is the prefix xor of p,
+// computed a block at a time and carried to the next block.
+static void divideByXPlus1(Poly::Block* p, unsigned n) {
+    Poly::Block carry = 0;
+    for (unsigned i = 0; i < n; i++) {
+        Poly::Block q = p[i];
+        q ^= q << 1;
+        q ^= q << 2;
+        q ^= q << 4;
+        q ^= q << 8;
+        q ^= q << 16;
+        q ^= q << 32;
+        q ^= carry;
+        p[i] = q;
+        carry = -(q >> (Poly::BLOCK_SIZE - 1));
+    }
+}
+
+// Clears the bits of p[0, n) from bit nBits up
+static void clearBitsFrom(Poly::Block* p, unsigned n, unsigned nBits) {
+    unsigned firstBlock = nBits / Poly::BLOCK_SIZE;
+    if (firstBlock >= n) {
+        return;
+    }
+
+    p[firstBlock] &= (((Poly::Block) 1) << (nBits % Poly::BLOCK_SIZE)) - 1;
+    for (unsigned i = firstBlock + 1; i < n; i++) {
+        p[i] = 0;
+    }
+}
+
+// The shifted src is xored straight into the blocks of this
+void Poly::addShifted(const Poly& src, unsigned bitOffset) {
+    if (&src == this) {
+        Poly copy = src;
+        this->addShifted(copy, bitOffset);
+        return;
+    }
+    if (src.size() == 0) {
+        return;
+    }
+
+    int srcDegree = src.degree() + bitOffset;
+    int thisDegree = this->degree();
+    unsigned nBlocks = std::max(this->numUsedBlocks(), (unsigned) srcDegree / BLOCK_SIZE + 1);
+    unsigned previousUsed = this->prepareBlocks(nBlocks);
+
+    xorShiftedLeft(this->data(), nBlocks, src.data(), src.numUsedBlocks(), bitOffset);
+
+    if (thisDegree != srcDegree) {
+        this->finishBlocks(nBlocks, previousUsed, std::max(thisDegree, srcDegree));
+    } else {
+        this->finishBlocks(nBlocks, previousUsed);
+    }
+}
+
+void Poly::addShiftedBlocks(const Poly& src, unsigned blockOffset) {
+    this->addShifted(src, blockOffset * BLOCK_SIZE);
+}
+
+/*****************************************************************************\
+|*                      Multiplication implementation                        *|
+\*****************************************************************************/
+
+// res must not be one of the operands
+void Poly::doMultiply(const Poly& other, Poly& res, const MultiplyThresholds& thresholds) const {
     if (this->size() == 0 or other.size() == 0) {
-        return Poly::fromInt(0);
+        res.setToBlock(0);
+        return;
     }
 
     unsigned nBlocks = std::max(this->numUsedBlocks(), other.numUsedBlocks());
-    static const bool debug = false;
-    //TODO compute the degree before returning
 
-    if (nBlocks > 1) {
-        if (debug) {
-            std::cout << "Doing karatsuba big" << std::endl;
-        }
+    if (nBlocks >= thresholds.fft) {
+        this->doMultiplyFFT(other, res, thresholds);
+        return;
+    }
 
-        return this->doMultiplyKaratsubaBig(other, splitLimit);
+    if (nBlocks > 1) {
+        this->doMultiplyBig(other, res, thresholds);
+        return;
     }
 
     unsigned size = std::max(this->size(), other.size());
 
-   /* if (size <= 8) {
-    }
-    */
-
     if (size <= 16) {
-        if (debug) {
-            std::cout << "Doing karatsuba 16" << std::endl;
-        }
-        return this->doMultiplyKaratsuba16(other, splitLimit);
+        this->doMultiplyKaratsuba16(other, res);
+        return;
     }
 
     if (size <= 32) {
-        if (debug) {
-            std::cout << "Doing karatsuba 32" << std::endl;
-        }
-        return this->doMultiplyKaratsuba32(other, splitLimit);
+        this->doMultiplyKaratsuba32(other, res);
+        return;
     }
 
-    if (debug) {
-        std::cout << "Doing karatsuba 64" << std::endl;
+    this->doMultiplyKaratsuba64(other, res);
+}
+
+void Poly::doMultiplyKaratsuba16(const Poly& other, Poly& res) const {
+    POLY_COUNT(KERNEL_16);
+    res.setToBlock(fast_convolution_16_32(this->block(0), other.block(0)));
+}
+
+void Poly::doMultiplyKaratsuba32(const Poly& other, Poly& res) const {
+    POLY_COUNT(KERNEL_32);
+    res.setToBlock(fast_convolution_32_64(this->block(0), other.block(0)));
+}
+
+// The 64 bits leaf is a single kernel call, done with CLMUL if available
+void Poly::doMultiplyKaratsuba64(const Poly& other, Poly& res) const {
+    POLY_COUNT(KERNEL_64);
+    Block high, low;
+    fast_convolution_64_128(this->block(0), other.block(0), high, low);
+
+    unsigned previousUsed = res.prepareBlocks(2);
+    res.setBlock(1, high);
+    res.setBlock(0, low);
+    res.finishBlocks(2, previousUsed, this->degree() + other.degree());
+}
+
+// The recursion works on raw blocks taken from the thread's workspace, which
+// is sized once for the whole call.
+void Poly::doMultiplyBig(const Poly& other, Poly& res, const MultiplyThresholds& thresholds) const {
+    POLY_COUNT(MULTIPLY_BIG);
+    POLY_TIME(MULTIPLY_TIME);
+    unsigned n = std::max(this->numUsedBlocks(), other.numUsedBlocks());
+
+    Workspace& workspace = Workspace::forThisThread();
+    workspace.reserve(2 * n + multiplyScratchSize(n));
+    unsigned mark = workspace.mark();
+
+    // Copy the operands so that both have n blocks
+    Block* a = workspace.allocate(n);
+    Block* b = workspace.allocate(n);
+    for (unsigned i = 0; i < n; i++) {
+        a[i] = this->block(i);
+        b[i] = other.block(i);
     }
 
-    Poly res = this->doMultiplyKaratsuba64(other, splitLimit);
-    res.computeDegree();
-    return res;
+    unsigned previousUsed = res.prepareBlocks(2 * n);
+    multiplyBlocks(a, b, n, res.data(), workspace.allocate(multiplyScratchSize(n)), thresholds);
+    res.finishBlocks(2 * n, previousUsed, this->degree() + other.degree());
+
+    workspace.release(mark);
 }
 
-Poly Poly::doMultiplyKaratsuba16(const Poly& other, unsigned) const {
-    return Poly::fromInt(convolution_16_32(this->block(0), other.block(0)));
+// A bound of the scratch needed by any of the algorithms for n blocks, every
+// level uses less than 4n + 16 blocks and recurses on at most (n + 3) / 2 blocks.
+// The levels run in parallel give each of their at most 5 products a bound of
+// its own.
+unsigned Poly::multiplyScratchSize(unsigned n) {
+    if (n <= 3) {
+        return 64;
+    }
+
+    unsigned copies = multiplyInParallel(n) ? 5 : 1;
+    return 4 * n + 16 + copies * multiplyScratchSize((n + 3) / 2);
 }
 
-Poly Poly::doMultiplyKaratsuba32(const Poly& other, unsigned) const {
-    return Poly::fromInt(convolution_32_64(this->block(0), other.block(0)));
+// res[0, 2n) = a[0, n) * b[0, n), scratch must have multiplyScratchSize(n) blocks
+void Poly::multiplyBlocks(const Block* a, const Block* b, unsigned n, Block* res, Block* scratch, const MultiplyThresholds& thresholds) {
+    if (n == 1) {
+        POLY_COUNT(KERNEL_64);
+        fast_convolution_64_128(a[0], b[0], res[1], res[0]);
+        return;
+    }
+
+    POLY_RECURSION();
+
+    // Toom-3 needs three non empty parts
+    if (n >= thresholds.toom3 and n >= 7) {
+        toom3Blocks(a, b, n, res, scratch, thresholds);
+    } else if (n >= thresholds.karatsuba) {
+        karatsubaBlocks(a, b, n, res, scratch, thresholds);
+    } else {
+        basecaseBlocks(a, b, n, res);
+    }
 }
 
-Poly Poly::doMultiplyKaratsuba64(const Poly& other, unsigned splitLimit) const {
-    static const bool debug = false;
-    Poly a1 = Poly::fromInt(other.block(0) >> 32);
-    Poly a0 = Poly::fromInt(other.block(0) & 0xFFFFFFFF);
+bool Poly::multiplyInParallel(unsigned n) {
+    return n >= parallelMultiplyThreshold and ThreadPool::global().numThreads() > 1;
+}
 
-    Poly b1 = Poly::fromInt(this->block(0) >> 32);
-    Poly b0 = Poly::fromInt(this->block(0) & 0xFFFFFFFF);
+// The products run as tasks with a slice of scratch each, as the workspace
+// of the thread running them may be in use. The first one runs on this
+// thread and subproducts still above the threshold spawn tasks in turn.
+void Poly::multiplyBlocksParallel(const BlockProduct* products, unsigned count, Block* scratch, const MultiplyThresholds& thresholds) {
+    unsigned maxN = 0;
+    for (unsigned i = 0; i < count; i++) {
+        maxN = std::max(maxN, products[i].n);
+    }
+    unsigned sliceSize = multiplyScratchSize(maxN);
+
+    TaskGroup group(ThreadPool::global());
+    for (unsigned i = 1; i < count; i++) {
+        const BlockProduct& product = products[i];
+        Block* ownScratch = scratch + i * sliceSize;
+        group.run([&product, ownScratch, &thresholds]() {
+            multiplyBlocks(product.a, product.b, product.n, product.res, ownScratch, thresholds);
+        });
+    }
 
-    Poly c2 = a1.doMultiplyKaratsuba32(b1, splitLimit);
-    Poly c0 = a0.doMultiplyKaratsuba32(b0, splitLimit);
-    Poly c1 = (a1 + a0).doMultiplyKaratsuba32(b1 + b0, splitLimit) - c2 - c0;
+    multiplyBlocks(products[0].a, products[0].b, products[0].n, products[0].res, scratch, thresholds);
+    group.wait();
+}
 
-    if (debug) {
-        std::cout << " a: " << other << std::endl;
-        std::cout << "a1: " << a1 << std::endl;
-        std::cout << "a0: " << a0 << std::endl;
+void Poly::basecaseBlocks(const Block* a, const Block* b, unsigned n, Block* res) {
+    POLY_COUNT(BASECASE_BLOCKS);
+    POLY_COUNT_N(KERNEL_64, n * n);
+    for (unsigned i = 0; i < 2 * n; i++) {
+        res[i] = 0;
+    }
 
-        std::cout << std::endl;
+    for (unsigned i = 0; i < n; i++) {
+        for (unsigned j = 0; j < n; j++) {
+            Block high, low;
+            fast_convolution_64_128(a[i], b[j], high, low);
+            res[i + j] ^= low;
+            res[i + j + 1] ^= high;
+        }
+    }
+}
 
-        std::cout << " b: " << *this << std::endl;
-        std::cout << "b1: " << b1 << std::endl;
-        std::cout << "b0: " << b0 << std::endl;
+void Poly::karatsubaBlocks(const Block* a, const Block* b, unsigned n, Block* res, Block* scratch, const MultiplyThresholds& thresholds) {
+    POLY_COUNT(KARATSUBA_BLOCKS);
+    unsigned cut = (n + 1) / 2;
+    unsigned high = n - cut;
 
-        std::cout << std::endl;
+    // c0 and c2 are computed directly in the low and high parts of res
+    Block* c0 = res;
+    Block* c2 = res + 2 * cut;
 
-        std::cout << "c2: " << c2 << std::endl;
-        std::cout << "c1: " << c1 << std::endl;
-        std::cout << "c0: " << c0 << std::endl;
+    Block* aSum = scratch;
+    Block* bSum = scratch + cut;
+    Block* c1 = scratch + 2 * cut;
+    Block* nextScratch = scratch + 4 * cut;
 
-        std::cout << std::endl;
+    for (unsigned i = 0; i < cut; i++) {
+        aSum[i] = a[i] ^ (i < high ? a[cut + i] : 0);
+        bSum[i] = b[i] ^ (i < high ? b[cut + i] : 0);
     }
 
-    Poly res;
+    if (multiplyInParallel(n)) {
+        const BlockProduct products[3] = {
+            {a, b, cut, c0},
+            {a + cut, b + cut, high, c2},
+            {aSum, bSum, cut, c1},
+        };
+        multiplyBlocksParallel(products, 3, nextScratch, thresholds);
+    } else {
+        multiplyBlocks(a, b, cut, c0, nextScratch, thresholds);
+        multiplyBlocks(a + cut, b + cut, high, c2, nextScratch, thresholds);
+        multiplyBlocks(aSum, bSum, cut, c1, nextScratch, thresholds);
+    }
 
-    Block res1 = c2.block(0) ^ (c1.block(0) >> 32);
-    Block res0 = c0.block(0) ^ ((c1.block(0) & 0xFFFFFFFF) << 32);
+    for (unsigned i = 0; i < 2 * cut; i++) {
+        c1[i] ^= c0[i] ^ (i < 2 * high ? c2[i] : 0);
+    }
 
-    res.setBlock(1, res1);
-    res.setBlock(0, res0);
+    xorBlocks(res + cut, c1, 2 * cut);
+}
 
-    if (debug) {
-        if ((this->multiplyNaively(other) + res).size() != 0) {
-            std::cout << "Error in Karatsuba64" << std::endl;
-        }
+// Values of p = p0 + p1 y + p2 y^2 at y = 1, x and x + 1, p1 has k blocks
+// and p2 has h blocks. The values at x and x + 1 have k + 1 blocks.
+static void evaluateToom3(const Poly::Block* p, unsigned k, unsigned h, Poly::Block* at1, Poly::Block* atX, Poly::Block* atX1) {
+    for (unsigned i = 0; i < k; i++) {
+        at1[i] = p[i] ^ p[k + i] ^ (i < h ? p[2 * k + i] : 0);
+        atX[i] = p[i];
     }
+    atX[k] = 0;
 
-    return res;
+    xorShiftedLeft(atX, k + 1, p + k, k, 1);
+    xorShiftedLeft(atX, k + 1, p + 2 * k, h, 2);
+
+    // p(x + 1) = p(1) + p(x) + p0
+    for (unsigned i = 0; i < k; i++) {
+        atX1[i] = atX[i] ^ at1[i] ^ p[i];
+    }
+    atX1[k] = atX[k];
 }
 
-Poly Poly::doMultiplyKaratsubaBig(const Poly& other, unsigned splitLimit) const {
-    unsigned nBlocks = std::max(this->numUsedBlocks(), other.numUsedBlocks());
-    static const bool debug = false;
-    unsigned cut = (nBlocks + 1) / 2;
+// Toom-3 over GF(2)[x] with the points 0, 1, x, x + 1 and infinity. With
+// c(y) = c0 + c1 y + c2 y^2 + c3 y^3 + c4 y^4 the interpolation is
+//   s  = c(1) + c0 + c4                          = c1 + c2 + c3
+//   u  = (c(x) + c0 + x^4 c4) / x                = c1 + c2 x + c3 x^2
+//   v  = (c(x + 1) + c0 + (x^4 + 1) c4) / (x + 1) = c1 + c2 (x + 1) + c3 (x + 1)^2
+//   u' = (u + s) / (x + 1)                       = c2 + c3 (x + 1)
+//   v' = (v + s) / x                             = c2 + c3 x
+// then c3 = u' + v', c2 = v' + x c3 and c1 = s + c2 + c3, all divisions are exact.
+void Poly::toom3Blocks(const Block* a, const Block* b, unsigned n, Block* res, Block* scratch, const MultiplyThresholds& thresholds) {
+    POLY_COUNT(TOOM3_BLOCKS);
+    unsigned k = (n + 2) / 3;
+    unsigned h = n - 2 * k;
+
+    Block* a1 = scratch;
+    Block* b1 = a1 + k;
+    Block* aX = b1 + k;
+    Block* bX = aX + k + 1;
+    Block* aX1 = bX + k + 1;
+    Block* bX1 = aX1 + k + 1;
+    Block* w1 = bX1 + k + 1;
+    Block* wX = w1 + 2 * k;
+    Block* wX1 = wX + 2 * k + 2;
+    Block* nextScratch = wX1 + 2 * k + 2;
+
+    evaluateToom3(a, k, h, a1, aX, aX1);
+    evaluateToom3(b, k, h, b1, bX, bX1);
+
+    // c0 and c4 are computed directly in the low and high parts of res
+    Block* c0 = res;
+    Block* c4 = res + 4 * k;
+    if (multiplyInParallel(n)) {
+        const BlockProduct products[5] = {
+            {a, b, k, c0},
+            {a + 2 * k, b + 2 * k, h, c4},
+            {a1, b1, k, w1},
+            {aX, bX, k + 1, wX},
+            {aX1, bX1, k + 1, wX1},
+        };
+        multiplyBlocksParallel(products, 5, nextScratch, thresholds);
+    } else {
+        multiplyBlocks(a, b, k, c0, nextScratch, thresholds);
+        multiplyBlocks(a + 2 * k, b + 2 * k, h, c4, nextScratch, thresholds);
+        multiplyBlocks(a1, b1, k, w1, nextScratch, thresholds);
+        multiplyBlocks(aX, bX, k + 1, wX, nextScratch, thresholds);
+        multiplyBlocks(aX1, bX1, k + 1, wX1, nextScratch, thresholds);
+    }
+    for (unsigned i = 2 * k; i < 4 * k; i++) {
+        res[i] = 0;
+    }
+
+    // s in w1
+    xorBlocks(w1, c0, 2 * k);
+    xorBlocks(w1, c4, 2 * h);
+
+    // u in wX
+    xorBlocks(wX, c0, 2 * k);
+    xorShiftedLeft(wX, 2 * k + 2, c4, 2 * h, 4);
+    divideByX(wX, 2 * k + 2);
+
+    // v in wX1
+    xorBlocks(wX1, c0, 2 * k);
+    xorBlocks(wX1, c4, 2 * h);
+    xorShiftedLeft(wX1, 2 * k + 2, c4, 2 * h, 4);
+    divideByXPlus1(wX1, 2 * k + 2);
+
+    // u' in wX and v' in wX1
+    xorBlocks(wX, w1, 2 * k);
+    divideByXPlus1(wX, 2 * k + 2);
+    xorBlocks(wX1, w1, 2 * k);
+    divideByX(wX1, 2 * k + 2);
+
+    // c3 in wX, c2 in wX1 and c1 in w1
+    xorBlocks(wX, wX1, 2 * k + 2);
+    xorShiftedLeft(wX1, 2 * k + 2, wX, 2 * k + 2, 1);
+    xorBlocks(w1, wX1, 2 * k);
+    xorBlocks(w1, wX, 2 * k);
+
+    xorBlocks(res + k, w1, 2 * k);
+    xorBlocks(res + 2 * k, wX1, std::min(2 * k + 2, 2 * n - 2 * k));
+    xorBlocks(res + 3 * k, wX, std::min(2 * k + 2, 2 * n - 3 * k));
+}
 
-    Poly a1 = other.rightBlockShifted(cut);
-    Poly a0 = Poly::fromBlocks(other, 0, cut);
+/*****************************************************************************\
+|*                           FFT implementation                              *|
+\*****************************************************************************/
+
+// Schönhage's ternary FFT: the operands are cut in pieces of M bits which
+// are seen as elements of R = GF(2)[x] / (x^2L + x^L + 1). In R x^3L = 1 so
+// x^(3L / K) is a principal K-th root of unity for K = 3^k dividing 3L, and
+// K is odd so the inverse transform doesn't need a division. With M <= L the
+// products of pieces don't wrap around and the cyclic convolution of length K
+// holds the whole product when each operand has at most (K + 1) / 2 pieces.
+//
+// The elements are kept reduced, of degree < 2L, in blocks of width blocks
+// which have room for 3L bits.
+struct TernaryRing {
+    typedef Poly::Block Block;
+
+    TernaryRing(unsigned L) : L(L), width((3 * L + Poly::BLOCK_SIZE - 1) / Poly::BLOCK_SIZE), temp(width) {
+    }
 
-    Poly b1 = this->rightBlockShifted(cut);
-    Poly b0 = Poly::fromBlocks(*this, 0, cut);
+    // Reduces p of degree < 3L using x^2L = x^L + 1
+    void fold(Block* p) {
+        std::fill(temp.begin(), temp.end(), 0);
+        xorShiftedRight(temp.data(), width, p, width, 2 * L);
+        clearBitsFrom(p, width, 2 * L);
+        xorBlocks(p, temp.data(), width);
+        xorShiftedLeft(p, width, temp.data(), width, L);
+    }
 
-    a1.computeDegree();
-    a0.computeDegree();
-    b1.computeDegree();
-    b0.computeDegree();
+    // dst = src * x^e with e < 3L, which is a rotation of the 3L bits
+    void multiplyByXPower(const Block* src, unsigned e, Block* dst) {
+        std::fill(dst, dst + width, 0);
+        xorShiftedLeft(dst, width, src, width, e);
+        clearBitsFrom(dst, width, 3 * L);
+        if (e != 0) {
+            xorShiftedRight(dst, width, src, width, 3 * L - e);
+        }
+        this->fold(dst);
+    }
 
-    Poly c2 = a1.doMultiplyKaratsuba(b1, splitLimit);
-    Poly c0 = a0.doMultiplyKaratsuba(b0, splitLimit);
+    // DFT of the K elements of v with the root x^e, tmp must be as big as v.
+    // Radix 3 decimation in time, with rho = x^(eK/3) a cube root of unity:
+    //   y_j          = A0_j + t1 + t2
+    //   y_(j+K/3)    = A0_j + rho t1 + rho^2 t2
+    //   y_(j+2K/3)   = A0_j + rho^2 t1 + rho t2 = y_(j+K/3) + t1 + t2
+    // where t1 = x^(je) A1_j and t2 = x^(2je) A2_j.
+    void fft(Block* v, unsigned K, unsigned e, Block* tmp, Block* work) {
+        if (K == 1) {
+            return;
+        }
 
-    Poly c1 = (a1 + a0).doMultiplyKaratsuba(b1 + b0, splitLimit) - c2 - c0;
+        unsigned third = K / 3;
+        unsigned modulus = 3 * L;
 
-    if (debug) {
-        std::cout << " a: " << other << std::endl;
-        std::cout << "a1: " << a1 << std::endl;
-        std::cout << "a0: " << a0 << std::endl;
+        for (unsigned i = 0; i < K; i++) {
+            std::copy(v + i * width, v + (i + 1) * width, tmp + ((i % 3) * third + i / 3) * width);
+        }
 
-        std::cout << std::endl;
+        unsigned subE = (unsigned) ((3ull * e) % modulus);
+        for (unsigned g = 0; g < 3; g++) {
+            this->fft(tmp + g * third * width, third, subE, v + g * third * width, work);
+        }
 
-        std::cout << " b: " << *this << std::endl;
-        std::cout << "b1: " << b1 << std::endl;
-        std::cout << "b0: " << b0 << std::endl;
+        unsigned rho = (unsigned) (((unsigned long long) e * third) % modulus);
+        Block* t1 = work;
+        Block* t2 = work + width;
+        Block* mixed = work + 2 * width;
+        Block* rhoMixed = work + 3 * width;
+
+        for (unsigned j = 0; j < third; j++) {
+            const Block* a0 = tmp + j * width;
+            const Block* a1 = tmp + (third + j) * width;
+            const Block* a2 = tmp + (2 * third + j) * width;
+
+            unsigned e1 = (unsigned) (((unsigned long long) j * e) % modulus);
+            unsigned e2 = (unsigned) ((2ull * e1) % modulus);
+            this->multiplyByXPower(a1, e1, t1);
+            this->multiplyByXPower(a2, e2, t2);
+
+            // rho t1 + rho^2 t2 = rho (t1 + rho t2)
+            this->multiplyByXPower(t2, rho, mixed);
+            xorBlocks(mixed, t1, width);
+            this->multiplyByXPower(mixed, rho, rhoMixed);
+
+            Block* y0 = v + j * width;
+            Block* y1 = v + (third + j) * width;
+            Block* y2 = v + (2 * third + j) * width;
+            for (unsigned i = 0; i < width; i++) {
+                y0[i] = a0[i] ^ t1[i] ^ t2[i];
+                y1[i] = a0[i] ^ rhoMixed[i];
+                y2[i] = y1[i] ^ t1[i] ^ t2[i];
+            }
+        }
+    }
 
-        std::cout << std::endl;
+    unsigned L;
+    unsigned width;
+    std::vector<Block> temp;
+};
+
+void Poly::doMultiplyFFT(const Poly& other, Poly& res, const MultiplyThresholds& thresholds) const {
+    POLY_COUNT(MULTIPLY_FFT);
+    POLY_TIME(MULTIPLY_TIME);
+    unsigned nBits = std::max(this->size(), other.size());
+
+    // Pick K = 3^k with a rough cost model: K products of 2L bits plus the
+    // three transforms of K log(K) rotations of 3L bits.
+    unsigned K = 0;
+    unsigned M = 0;
+    unsigned L = 0;
+    double bestCost = 0;
+    unsigned depth = 1;
+    for (unsigned candidate = 3; (candidate + 1) / 2 <= nBits and candidate <= UINT_MAX / 3; candidate *= 3, depth++) {
+        unsigned nPieces = (candidate + 1) / 2;
+        unsigned candidateM = (nBits + nPieces - 1) / nPieces;
+        unsigned third = candidate / 3;
+        unsigned candidateL = (candidateM + third - 1) / third * third;
+
+        double productBlocks = 2.0 * candidateL / BLOCK_SIZE + 1;
+        double cost = candidate * (std::pow(productBlocks, 1.58) + 9.0 * depth * productBlocks);
+        if (K == 0 or cost < bestCost) {
+            K = candidate;
+            M = candidateM;
+            L = candidateL;
+            bestCost = cost;
+        }
+    }
 
-        std::cout << "c2: " << c2 << std::endl;
-        std::cout << "c1: " << c1 << std::endl;
-        std::cout << "c0: " << c0 << std::endl;
+    TernaryRing ring(L);
+    unsigned width = ring.width;
+    unsigned productBlocks = (2 * L + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+    // Cut the operands in pieces of M bits
+    std::vector<Block> a(K * width, 0);
+    std::vector<Block> b(K * width, 0);
+    for (unsigned i = 0; i < (K + 1) / 2; i++) {
+        xorShiftedRight(a.data() + i * width, width, this->data(), this->numUsedBlocks(), i * M);
+        clearBitsFrom(a.data() + i * width, width, M);
+        xorShiftedRight(b.data() + i * width, width, other.data(), other.numUsedBlocks(), i * M);
+        clearBitsFrom(b.data() + i * width, width, M);
+    }
 
-        std::cout << std::endl;
+    std::vector<Block> tmp(K * width);
+    std::vector<Block> work(4 * width);
+    unsigned root = 3 * L / K;
+    ring.fft(a.data(), K, root, tmp.data(), work.data());
+    ring.fft(b.data(), K, root, tmp.data(), work.data());
+
+    // Pointwise products, reduced first with x^3L = 1 then with fold
+    Workspace& workspace = Workspace::forThisThread();
+    workspace.reserve(2 * productBlocks + multiplyScratchSize(productBlocks));
+    unsigned mark = workspace.mark();
+    Block* product = workspace.allocate(2 * productBlocks);
+    Block* scratch = workspace.allocate(multiplyScratchSize(productBlocks));
+
+    for (unsigned i = 0; i < K; i++) {
+        Block* ai = a.data() + i * width;
+        multiplyBlocks(ai, b.data() + i * width, productBlocks, product, scratch, thresholds);
+
+        std::fill(ai, ai + width, 0);
+        xorBlocks(ai, product, std::min(width, 2 * productBlocks));
+        clearBitsFrom(ai, width, 3 * L);
+        xorShiftedRight(ai, width, product, 2 * productBlocks, 3 * L);
+        ring.fold(ai);
     }
 
-    Poly c2Shifted = c2.leftBlockShifted(cut * 2);
-    Poly c1Shifted = c1.leftBlockShifted(cut);
-    
-    c2Shifted.computeDegree();
-    c1Shifted.computeDegree();
+    workspace.release(mark);
 
-    Poly res = c2Shifted + c1Shifted + c0;
-    
-    if (debug) {
-        if ((this->multiplyNaively(other) + res).size() != 0) {
-            std::cout << "Error in KaratsubaBig" << std::endl;
-        }else {
-            std::cout << "Ok" << std::endl;
+    ring.fft(a.data(), K, 3 * L - root, tmp.data(), work.data());
+
+    // The coefficients have degree < 2M - 1 so they are exact, add them back
+    unsigned nBlocks = ((K - 1) * M + 2 * L) / BLOCK_SIZE + 1;
+    unsigned previousUsed = res.prepareBlocks(nBlocks);
+    std::fill(res.data(), res.data() + nBlocks, 0);
+    for (unsigned i = 0; i < K; i++) {
+        xorShiftedLeft(res.data(), nBlocks, a.data() + i * width, width, i * M);
+    }
+    res.finishBlocks(nBlocks, previousUsed, this->degree() + other.degree());
+}
+
+/*****************************************************************************\
+|*                          Division implementation                          *|
+\*****************************************************************************/
+
+// Schoolbook division done a block of the quotient at a time, see
+// reduceBlocks. this must be at least as big as b.
+void Poly::doDivideBlocks(const Poly& b, Poly& q, Poly& r) const {
+    r = *this;
+    r.reduceBlocks(b, b.topBlockReciprocal(), &q);
+}
+
+// The top 64 bits of the remainder and of b are enough to know the next 64
+// bits of the quotient, which come out of a single carry-less product with
+// the reciprocal of the top of b. The remainder is then updated in place
+// with that quotient block times b, with no shift since the quotient blocks
+// are aligned. inverse must be b.topBlockReciprocal() and the quotient is
+// only stored when q isn't null.
+void Poly::reduceBlocks(const Poly& b, Block inverse, Poly* q) {
+    if (this->size() < b.size()) {
+        if (q != nullptr) {
+            q->setToBlock(0);
         }
+        return;
     }
 
-    return res;
+    int bDegree = b.degree();
+    int qDegree = this->degree() - bDegree;
+    unsigned bNBlocks = b.numUsedBlocks();
+    unsigned qNBlocks = qDegree / BLOCK_SIZE + 1;
+
+    unsigned qPreviousUsed = 0;
+    Block* qBlocks = nullptr;
+    if (q != nullptr) {
+        qPreviousUsed = q->prepareBlocks(qNBlocks);
+        qBlocks = q->data();
+    }
+    unsigned rPreviousUsed = this->prepareBlocks(qNBlocks + bNBlocks + 1);
+    Block* rBlocks = this->data();
+    const Block* bBlocks = b.data();
+
+    for (unsigned k = qNBlocks; k-->0;) {
+        // Bits [64k + deg(b), 64k + deg(b) + 64) of the remainder, the
+        // ones above have been cleared by the previous quotient blocks
+        unsigned start = k * BLOCK_SIZE + bDegree;
+        Block rTop = rBlocks[start / BLOCK_SIZE] >> (start % BLOCK_SIZE);
+        if (start % BLOCK_SIZE != 0) {
+            rTop |= rBlocks[start / BLOCK_SIZE + 1] << (BLOCK_SIZE - start % BLOCK_SIZE);
+        }
+
+        Block high, low;
+        fast_convolution_64_128(rTop, inverse, high, low);
+        Block qBlock = (high << 1) | (low >> (BLOCK_SIZE - 1));
+        POLY_COUNT(DIVISION_BLOCKS);
+        if (qBlocks != nullptr) {
+            qBlocks[k] = qBlock;
+        }
+
+        if (qBlock == 0) {
+            continue;
+        }
+        for (unsigned j = 0; j < bNBlocks; j++) {
+            fast_convolution_64_128(qBlock, bBlocks[j], high, low);
+            rBlocks[k + j] ^= low;
+            rBlocks[k + j + 1] ^= high;
+        }
+    }
+
+    if (q != nullptr) {
+        q->finishBlocks(qNBlocks, qPreviousUsed, qDegree);
+    }
+    this->finishBlocks(bNBlocks, std::max(rPreviousUsed, qNBlocks + bNBlocks + 1));
+}
+
+// reciprocal_64 of the top 64 bits of this, the leading coefficient being
+// put at bit 63. this must not be 0.
+Poly::Block Poly::topBlockReciprocal() const {
+    const Block* blocks = this->data();
+    Block top;
+    if (this->degree() >= (int) BLOCK_SIZE - 1) {
+        unsigned start = this->degree() - (BLOCK_SIZE - 1);
+        top = blocks[start / BLOCK_SIZE] >> (start % BLOCK_SIZE);
+        if (start % BLOCK_SIZE != 0) {
+            top |= blocks[start / BLOCK_SIZE + 1] << (BLOCK_SIZE - start % BLOCK_SIZE);
+        }
+    } else {
+        top = blocks[0] << (BLOCK_SIZE - 1 - this->degree());
+    }
+    return reciprocal_64(top);
+}
+
+// With rev_k(p) = x^k p(1/x) and n, m, k the degrees of this, b and q,
+// this = q * b + r becomes rev_n(this) = rev_k(q) * rev_m(b) mod x^(k + 1).
+// The inverse of rev_m(b) comes from Newton iteration, after which q and r
+// only cost two multiplications. this must be at least as big as b.
+void Poly::doDivideNewton(const Poly& b, Poly& q, Poly& r) const {
+    unsigned n = this->degree();
+    unsigned m = b.degree();
+    unsigned k = n - m;
+
+    Poly bReversed, inverse;
+    b.reverse(m + 1, bReversed);
+    bReversed.inverseSeries(k + 1, inverse);
+
+    Poly aReversed, qReversed;
+    this->reverse(n + 1, aReversed);
+    aReversed.truncate(k + 1);
+    aReversed.multiply(inverse, qReversed);
+    qReversed.truncate(k + 1);
+    qReversed.reverse(k + 1, q);
+
+    b.multiply(q, r);
+    r += *this;
+}
+
+// res = 1 / this mod x^precision, this must have its constant coefficient
+// set. Over GF(2) the Newton step g <- g * (2 - f * g) is g <- f * g^2, and
+// squaring being linear only one real multiplication is done per step.
+void Poly::inverseSeries(unsigned precision, Poly& res) const {
+    res.setToBlock(series_inverse_64(this->block(0)));
+    res.truncate(precision);
+
+    Poly gSquared, fLow;
+    for (unsigned p = BLOCK_SIZE; p < precision;) {
+        p = std::min(2 * p, precision);
+        POLY_COUNT(NEWTON_STEPS);
+        res.square(gSquared);
+        gSquared.truncate(p);
+        fLow = *this;
+        fLow.truncate(p);
+        fLow.multiply(gSquared, res);
+        res.truncate(p);
+    }
+}
+
+// res = x^(nBits - 1) * this(1/x), the bits of this past nBits are dropped.
+// res must not be this.
+void Poly::reverse(unsigned nBits, Poly& res) const {
+    unsigned nBlocks = (nBits + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    unsigned previousUsed = res.prepareBlocks(nBlocks);
+
+    for (unsigned i = 0; i < nBlocks; i++) {
+        res.setBlock(i, reverse_64(this->block(nBlocks - 1 - i)));
+    }
+    res.finishBlocks(nBlocks, previousUsed);
+
+    // The blocks were reversed whole, the padding ends up at the bottom
+    res.shiftRight(nBlocks * BLOCK_SIZE - nBits, res);
+}
+
+// Reduces this modulo x^nBits
+void Poly::truncate(unsigned nBits) {
+    unsigned nBlocks = (nBits + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    unsigned previousUsed = this->numUsedBlocks();
+    if (nBlocks > previousUsed) {
+        return;
+    }
+
+    if (nBits % BLOCK_SIZE != 0) {
+        Block mask = (((Block) 1) << (nBits % BLOCK_SIZE)) - 1;
+        this->setBlock(nBlocks - 1, this->block(nBlocks - 1) & mask);
+    }
+    this->finishBlocks(nBlocks, previousUsed);
 }
 
 /*****************************************************************************\
 |*                                      IO                                   *|
 \*****************************************************************************/ 
 
+// The hex digits are converted 8 at a time in a word (SWAR), each byte of
+// the word holding a digit. spreadNibbles puts nibble i of v in byte i and
+// gatherNibbles does the reverse.
+static inline uint64_t spreadNibbles(uint32_t v) {
+    uint64_t x = v;
+    x = (x | (x << 16)) & 0x0000FFFF0000FFFF;
+    x = (x | (x << 8)) & 0x00FF00FF00FF00FF;
+    x = (x | (x << 4)) & 0x0F0F0F0F0F0F0F0F;
+    return x;
+}
+
+static inline uint32_t gatherNibbles(uint64_t x) {
+    x = (x | (x >> 4)) & 0x00FF00FF00FF00FF;
+    x = (x | (x >> 8)) & 0x0000FFFF0000FFFF;
+    x = (x | (x >> 16)) & 0x00000000FFFFFFFF;
+    return x;
+}
+
+// The first char in memory is the most significant digit, so the high byte
+static inline uint64_t loadDigits(const char* in) {
+    uint64_t x;
+    std::memcpy(&x, in, sizeof(x));
+    #if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        x = __builtin_bswap64(x);
+    #endif
+    return x;
+}
+
+static inline void storeDigits(uint64_t x, char* out) {
+    #if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        x = __builtin_bswap64(x);
+    #endif
+    std::memcpy(out, &x, sizeof(x));
+}
+
+// Writes the 16 digits of value, '0' + n for n < 10 and 'a' - 10 + n above
+static inline void encodeHexBlock(Poly::Block value, char* out) {
+    const uint64_t ONES = 0x0101010101010101;
+    for (unsigned half = 0; half < 2; half++) {
+        uint64_t nibbles = spreadNibbles(value >> (32 - 32 * half));
+        uint64_t letters = ((nibbles + 6 * ONES) >> 4) & ONES;
+        storeDigits(nibbles + '0' * ONES + letters * ('a' - '0' - 10), out + 8 * half);
+    }
+}
+
+// Reads the 16 digits at in, returns false if one isn't a hex digit. Each
+// byte is checked against the ranges of the digits with carry-free adds:
+// for c < 128, c + 128 - lo has its high bit set iff c >= lo. A byte with
+// its high bit set can carry into the next one but makes the word fail.
+static inline bool decodeHexBlock(const char* in, Poly::Block& value) {
+    const uint64_t ONES = 0x0101010101010101;
+    const uint64_t HIGH = 0x80 * ONES;
+    value = 0;
+    for (unsigned half = 0; half < 2; half++) {
+        uint64_t c = loadDigits(in + 8 * half);
+        uint64_t lower = c | 0x20 * ONES;
+        uint64_t isDigit = (c + (0x80 - '0') * ONES) & ~(c + (0x7F - '9') * ONES);
+        uint64_t isLetter = (lower + (0x80 - 'a') * ONES) & ~(lower + (0x7F - 'f') * ONES);
+        if (((isDigit | isLetter) & ~c & HIGH) != HIGH) {
+            return false;
+        }
+
+        // Letters have bit 6 set, their low nibble is 1 to 6
+        uint64_t nibbles = (c & 0x0F * ONES) + ((c >> 6) & ONES) * 9;
+        value = (value << 32) | gatherNibbles(nibbles);
+    }
+    return true;
+}
+
+bool Poly::fromHex(const char* begin, const char* end, Poly& res) {
+    const unsigned DIGITS_PER_BLOCK = BLOCK_SIZE / 4;
+
+    if (end - begin >= 2 and begin[0] == '0' and (begin[1] == 'x' or begin[1] == 'X')) {
+        begin += 2;
+    }
+    if (begin == end) {
+        res.setToBlock(0);
+        return false;
+    }
+    while (end - begin > 1 and *begin == '0') {
+        begin ++;
+    }
+
+    // The top block is padded with zeros to go through the same decoding
+    unsigned nDigits = end - begin;
+    unsigned nBlocks = (nDigits + DIGITS_PER_BLOCK - 1) / DIGITS_PER_BLOCK;
+    unsigned topDigits = nDigits - (nBlocks - 1) * DIGITS_PER_BLOCK;
+    char top[DIGITS_PER_BLOCK];
+    std::memset(top, '0', DIGITS_PER_BLOCK - topDigits);
+    std::memcpy(top + DIGITS_PER_BLOCK - topDigits, begin, topDigits);
+
+    unsigned previousUsed = res.prepareBlocks(nBlocks);
+    Block* blocks = res.data();
+    bool valid = decodeHexBlock(top, blocks[nBlocks - 1]);
+    const char* digits = begin + topDigits;
+    for (unsigned i = nBlocks - 1; i-->0 and valid;) {
+        valid = decodeHexBlock(digits, blocks[i]);
+        digits += DIGITS_PER_BLOCK;
+    }
+
+    if (not valid) {
+        res.finishBlocks(0, std::max(nBlocks, previousUsed), -1);
+        return false;
+    }
+
+    // Past the leading zeros the top digit isn't 0, unless the poly is 0
+    Block topBlock = blocks[nBlocks - 1];
+    int degree = topBlock == 0 ? -1 : (nBlocks - 1) * BLOCK_SIZE + log2_u64(topBlock);
+    res.finishBlocks(nBlocks, previousUsed, degree);
+    return true;
+}
+
+Poly Poly::fromHex(const std::string& hex) {
+    Poly res;
+    Poly::fromHex(hex.data(), hex.data() + hex.size(), res);
+    return res;
+}
+
+unsigned Poly::hexSize() const {
+    return this->size() == 0 ? 1 : this->degree() / 4 + 1;
+}
+
+char* Poly::toHex(char* out) const {
+    const unsigned DIGITS_PER_BLOCK = BLOCK_SIZE / 4;
+    if (this->size() == 0) {
+        *out = '0';
+        return out + 1;
+    }
+
+    // Only the significant digits of the top block are written
+    unsigned nBlocks = this->numUsedBlocks();
+    const Block* blocks = this->data();
+    unsigned topDigits = this->hexSize() - (nBlocks - 1) * DIGITS_PER_BLOCK;
+    char top[DIGITS_PER_BLOCK];
+    encodeHexBlock(blocks[nBlocks - 1], top);
+    std::memcpy(out, top + DIGITS_PER_BLOCK - topDigits, topDigits);
+    out += topDigits;
+
+    for (unsigned i = nBlocks - 1; i-->0;) {
+        encodeHexBlock(blocks[i], out);
+        out += DIGITS_PER_BLOCK;
+    }
+    return out;
+}
+
+std::string Poly::toHex() const {
+    std::string res(this->hexSize(), '0');
+    this->toHex(&res[0]);
+    return res;
+}
+
 std::ostream& operator<<(std::ostream& os, const Poly& p) {
     os << "(";
     for (int i = p.size(); i-->0;) {
@@ -3,9 +3,11 @@
 
 #include <cstdint>
 #include <iostream>
+#include <random>
+#include <string>
+#include <vector>
 
 //TODO make a free constructor for Poly
-//TODO things that return a Poly should instead take a Poly& as argument;
 
 class Poly {
     public:
@@ -13,8 +15,38 @@ class Poly {
         typedef int Bit;
         static constexpr unsigned BLOCK_SIZE = 64;
 
+        // Operand sizes, in blocks, from which each multiplication algorithm
+        // is used. Below karatsuba the blocks are multiplied schoolbook style.
+        struct MultiplyThresholds {
+            unsigned karatsuba;
+            unsigned toom3;
+            unsigned fft;
+        };
+
+        // Used by operator* and multiply, can be changed to tune for a machine
+        static MultiplyThresholds multiplyThresholds;
+        static const MultiplyThresholds KARATSUBA_ONLY;
+
+        // euclidianDivision goes through Newton iteration when both the
+        // quotient and the divisor have at least that many blocks
+        static unsigned newtonDivisionThreshold;
+
+        // Karatsuba and Toom-3 run their products as tasks on
+        // ThreadPool::global() from that many blocks
+        static unsigned parallelMultiplyThreshold;
+
+        // gcd and extendedGcd use the half GCD from that many blocks
+        static unsigned halfGcdThreshold;
+        static unsigned halfExtendedGcdThreshold;
+
         Poly();
         Poly(unsigned numBlocks);
+        Poly(const Poly& other);
+        Poly(Poly&& other);
+        ~Poly();
+
+        Poly& operator=(const Poly& other);
+        Poly& operator=(Poly&& other);
 
         static Poly fromInt(Block value);
 
@@ -23,7 +55,17 @@ class Poly {
         static Poly random(unsigned len);
 
         //takes [start, end)
-        static Poly fromBlocks(Poly origin, unsigned start, unsigned end);
+        static Poly fromBlocks(const Poly& origin, unsigned start, unsigned end);
+
+        // Hex text, the most significant digit first with bit i of the
+        // number being the coefficient of x^i, so x^4 + x + 1 is "13" and 0
+        // is "0". The parsers take an optional 0x and leading zeros, no
+        // whitespace. They work 16 digits, a block, at a time.
+        // Parses [begin, end) into res, returns false and sets res to 0 when
+        // it isn't hex.
+        static bool fromHex(const char* begin, const char* end, Poly& res);
+        // 0 when hex isn't hex
+        static Poly fromHex(const std::string& hex);
 
         Bit bit(unsigned i) const;
         Block block(unsigned i) const;
@@ -41,44 +83,154 @@ class Poly {
         Poly operator<<(int i) const;
         Poly operator>>(int i) const;
 
+        // Squaring is linear over GF(2), it only spreads the bits apart
+        Poly square() const;
+
+        Poly& operator+=(const Poly& other);
+        Poly& operator-=(const Poly& other);
+        Poly& operator*=(const Poly& other);
+        Poly& operator<<=(int i);
+        Poly& operator>>=(int i);
+
+        // Destination parameter versions of the operators, they reuse the
+        // storage of res and res can be one of the operands.
+        void add(const Poly& other, Poly& res) const;
+        void multiply(const Poly& other, Poly& res) const;
+        void multiply(const Poly& other, Poly& res, const MultiplyThresholds& thresholds) const;
+        // res[i] = a[i] * b[i] for a and b of the same size, with the
+        // bitsliced kernel on 64 or 256 at a time. It is meant for polys of
+        // degree < 64, the others go through multiply(). It only beats a
+        // loop of multiply() on the CPUs without CLMUL, with it the kernel
+        // is the same loop of single products.
+        static void multiplyBatch(const std::vector<Poly>& a, const std::vector<Poly>& b, std::vector<Poly>& res);
+        void square(Poly& res) const;
+        void shiftLeft(int i, Poly& res) const;
+        void shiftRight(int i, Poly& res) const;
+        // this += src * x^bitOffset without building the shifted src, src
+        // can be this. The block version is for offsets multiple of the
+        // block size, where the blocks are xored without shifting.
+        void addShifted(const Poly& src, unsigned bitOffset);
+        void addShiftedBlocks(const Poly& src, unsigned blockOffset);
+        //takes [start, end)
+        void blocks(unsigned start, unsigned end, Poly& res) const;
+
+        // Number of chars of toHex, there is no terminating 0
+        unsigned hexSize() const;
+        // Writes the hexSize() digits at out, returns the end of them
+        char* toHex(char* out) const;
+        std::string toHex() const;
+
         int computeDegree();
 
+        Poly derivative() const;
+        // this must be a square
+        Poly squareRoot() const;
+
         Poly leftBlockShifted(unsigned i) const;
         Poly rightBlockShifted(unsigned i) const;
 
         Poly multiplyNaively(const Poly& other) const;
+        // These only use Karatsuba, the names are kept from when they had
+        // different leaf sizes.
         Poly multiplyKaratsuba32(const Poly& other) const;
         Poly multiplyKaratsuba16(const Poly& other) const;
         Poly multiplyKaratsuba8(const Poly& other) const;
 
         void euclidianDivision(const Poly& b, Poly& q, Poly& r) const;
 
+        Poly gcd(const Poly& other) const;
+        // g = u * this + v * other with g the gcd, deg(u) < deg(other / g)
+        // and deg(v) < deg(this / g)
+        void extendedGcd(const Poly& other, Poly& g, Poly& u, Poly& v) const;
+
         void setBit(unsigned i, Bit value);
     private:
+        template<unsigned Bits> friend class FixedPoly;
+        friend class PolyModulus;
+        friend class PolyView;
+        friend class PolyCorpusWriter;
+        friend class SparsePoly;
+        friend struct PolyMatrix;
+
+        Block* data();
+        const Block* data() const;
+
         void setBlock(unsigned i, Block value);
+        void setToBlock(Block value);
         void xorBit(unsigned i, Bit value);
 
-        Poly doMultiplyKaratsuba(const Poly& other, unsigned splitLimit) const;
-        Poly doMultiplyKaratsuba8(const Poly& other, unsigned splitLimit) const;
-        Poly doMultiplyKaratsuba16(const Poly& other, unsigned splitLimit) const;
-        Poly doMultiplyKaratsuba32(const Poly& other, unsigned splitLimit) const;
-        Poly doMultiplyKaratsuba64(const Poly& other, unsigned splitLimit) const;
-        Poly doMultiplyKaratsubaBig(const Poly& other, unsigned splitLimit) const;
+        void reserve(unsigned nBlocks);
+        unsigned prepareBlocks(unsigned nBlocks);
+        void finishBlocks(unsigned nBlocks, unsigned previousUsed);
+        void finishBlocks(unsigned nBlocks, unsigned previousUsed, int degree);
+        int computeDegreeFrom(unsigned nBlocks);
+        void checkInvariants() const;
+
+        void doMultiply(const Poly& other, Poly& res, const MultiplyThresholds& thresholds) const;
+        void doMultiplyKaratsuba16(const Poly& other, Poly& res) const;
+        void doMultiplyKaratsuba32(const Poly& other, Poly& res) const;
+        void doMultiplyKaratsuba64(const Poly& other, Poly& res) const;
+        void doMultiplyBig(const Poly& other, Poly& res, const MultiplyThresholds& thresholds) const;
+        void doMultiplyFFT(const Poly& other, Poly& res, const MultiplyThresholds& thresholds) const;
+
+        void doDivideBlocks(const Poly& b, Poly& q, Poly& r) const;
+        void doDivideNewton(const Poly& b, Poly& q, Poly& r) const;
+        void reduceBlocks(const Poly& b, Block inverse, Poly* q);
+        Block topBlockReciprocal() const;
+        void inverseSeries(unsigned precision, Poly& res) const;
+        void reverse(unsigned nBits, Poly& res) const;
+        void truncate(unsigned nBits);
+
+        void doExtendedGcd(const Poly& other, Poly& g, Poly* u, Poly* v) const;
+        void setLinearCombination(Block u, const Poly& a, Block v, const Poly& b, unsigned shift);
+
+        // Multiplication of n blocks by n blocks on raw storage
+        struct BlockProduct {
+            const Block* a;
+            const Block* b;
+            unsigned n;
+            Block* res;
+        };
+        static unsigned multiplyScratchSize(unsigned n);
+        static void multiplyBlocks(const Block* a, const Block* b, unsigned n, Block* res, Block* scratch, const MultiplyThresholds& thresholds);
+        static bool multiplyInParallel(unsigned n);
+        static void multiplyBlocksParallel(const BlockProduct* products, unsigned count, Block* scratch, const MultiplyThresholds& thresholds);
+        static void basecaseBlocks(const Block* a, const Block* b, unsigned n, Block* res);
+        static void karatsubaBlocks(const Block* a, const Block* b, unsigned n, Block* res, Block* scratch, const MultiplyThresholds& thresholds);
+        static void toom3Blocks(const Block* a, const Block* b, unsigned n, Block* res, Block* scratch, const MultiplyThresholds& thresholds);
 
         static constexpr unsigned INLINE_SIZE = 256;
         static constexpr unsigned NUM_INLINE_BLOCKS = INLINE_SIZE / BLOCK_SIZE;
 
+        // Small polys live in inlineBlocks, bigger ones spill to heapBlocks
+        // which holds capacity blocks (heapBlocks is null when inline).
         Block inlineBlocks[NUM_INLINE_BLOCKS] = {0};
+        Block* heapBlocks = nullptr;
+        unsigned capacity = NUM_INLINE_BLOCKS;
         int deg = 0;
 };
 
 std::ostream& operator<<(std::ostream& os, const Poly& p);
 
+// Inline definitions, these are called for every temporary
+
+inline Poly::~Poly() {
+    delete[] this->heapBlocks;
+}
+
+inline Poly::Block* Poly::data() {
+    return this->heapBlocks != nullptr ? this->heapBlocks : this->inlineBlocks;
+}
+
+inline const Poly::Block* Poly::data() const {
+    return this->heapBlocks != nullptr ? this->heapBlocks : this->inlineBlocks;
+}
+
 // Templates definitions
 
 template<typename Generator>
 Poly Poly::random(unsigned len, Generator& g) {
-    Poly res((len + (BLOCK_SIZE - 1)) / BLOCK_SIZE);
+    Poly res(len / BLOCK_SIZE + 1);
 
     std::uniform_int_distribution<uint64_t> distrib;
 
@@ -87,12 +239,12 @@ Poly Poly::random(unsigned len, Generator& g) {
     }
 
     Block b = distrib(g);
-    b >>= (BLOCK_SIZE - len - 1);
+    b >>= (BLOCK_SIZE - len % BLOCK_SIZE - 1);
 
     res.setBlock(len / BLOCK_SIZE, b /*>> (BLOCK_SIZE - len - 1)*/);
 
     res.setBit(len, 1);
-    res.computeDegree();
+    res.finishBlocks(len / BLOCK_SIZE + 1, 0, len);
 
     return res;
 }
@@ -0,0 +1,297 @@
+#include <cstring>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "poly_corpus.h"
+
+static const char MAGIC[8] = {'P', 'O', 'L', 'Y', 'C', 'O', 'R', 'P'};
+static const uint32_t VERSION = 1;
+static const uint64_t ALIGNMENT = 64;
+
+static bool isLittleEndian() {
+    return __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__;
+}
+
+static uint64_t toLittleEndian(uint64_t v) {
+    return isLittleEndian() ? v : __builtin_bswap64(v);
+}
+
+static uint32_t toLittleEndian(uint32_t v) {
+    return isLittleEndian() ? v : __builtin_bswap32(v);
+}
+
+// Offset of the blocks of the record following data that ends at end, the
+// degree of the record goes in the 8 bytes before it
+static uint64_t nextBlocksOffset(uint64_t end) {
+    return (end + sizeof(int64_t) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+static uint64_t numBlocksOf(int64_t degree) {
+    return degree < 0 ? 0 : degree / Poly::BLOCK_SIZE + 1;
+}
+
+/*****************************************************************************\
+|*                                  PolyView                                 *|
+\*****************************************************************************/
+
+PolyView::PolyView() {
+}
+
+PolyView::PolyView(const Poly::Block* blocks, int degree) {
+    this->reset(blocks, degree);
+}
+
+PolyView::PolyView(const PolyView& other) {
+    this->reset(other.view.data(), other.view.degree());
+}
+
+// The blocks aren't ours, the Poly must not free them
+PolyView::~PolyView() {
+    this->view.heapBlocks = nullptr;
+}
+
+PolyView& PolyView::operator=(const PolyView& other) {
+    this->reset(other.view.data(), other.view.degree());
+    return *this;
+}
+
+void PolyView::reset(const Poly::Block* blocks, int degree) {
+    if (degree < 0) {
+        this->view.heapBlocks = nullptr;
+        this->view.capacity = Poly::NUM_INLINE_BLOCKS;
+        this->view.deg = -1;
+        return;
+    }
+
+    this->view.heapBlocks = const_cast<Poly::Block*>(blocks);
+    this->view.capacity = numBlocksOf(degree);
+    this->view.deg = degree;
+    this->view.checkInvariants();
+}
+
+const Poly& PolyView::poly() const {
+    return this->view;
+}
+
+/*****************************************************************************\
+|*                              PolyCorpusWriter                             *|
+\*****************************************************************************/
+
+PolyCorpusWriter::PolyCorpusWriter() : file(nullptr), written(0), offset(0) {
+}
+
+PolyCorpusWriter::~PolyCorpusWriter() {
+    if (this->file != nullptr) {
+        this->close();
+    }
+}
+
+bool PolyCorpusWriter::open(const std::string& path) {
+    if (this->file != nullptr) {
+        this->close();
+    }
+
+    this->file = std::fopen(path.c_str(), "wb");
+    if (this->file == nullptr) {
+        return false;
+    }
+
+    this->written = 0;
+    this->offset = sizeof(PolyCorpusHeader);
+    // The count is filled in by close
+    return this->writeHeader();
+}
+
+bool PolyCorpusWriter::write(const Poly& p) {
+    if (this->file == nullptr) {
+        return false;
+    }
+
+    uint64_t blocksOffset = nextBlocksOffset(this->offset);
+    if (not this->writeZeros(blocksOffset - sizeof(int64_t) - this->offset)) {
+        return false;
+    }
+
+    uint64_t degree = toLittleEndian((uint64_t) (int64_t) p.degree());
+    if (std::fwrite(&degree, sizeof(degree), 1, this->file) != 1) {
+        return false;
+    }
+
+    unsigned nBlocks = p.numUsedBlocks();
+    if (isLittleEndian()) {
+        if (std::fwrite(p.data(), sizeof(Poly::Block), nBlocks, this->file) != nBlocks) {
+            return false;
+        }
+    } else {
+        std::vector<Poly::Block> blocks(p.data(), p.data() + nBlocks);
+        for (Poly::Block& block : blocks) {
+            block = toLittleEndian(block);
+        }
+        if (std::fwrite(blocks.data(), sizeof(Poly::Block), nBlocks, this->file) != nBlocks) {
+            return false;
+        }
+    }
+
+    this->offset = blocksOffset + nBlocks * sizeof(Poly::Block);
+    this->written ++;
+    return true;
+}
+
+bool PolyCorpusWriter::close() {
+    if (this->file == nullptr) {
+        return false;
+    }
+
+    bool ok = std::fseek(this->file, 0, SEEK_SET) == 0 and this->writeHeader();
+    ok = std::fclose(this->file) == 0 and ok;
+    this->file = nullptr;
+    return ok;
+}
+
+uint64_t PolyCorpusWriter::count() const {
+    return this->written;
+}
+
+bool PolyCorpusWriter::writeHeader() {
+    PolyCorpusHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = toLittleEndian(VERSION);
+    header.blockSize = toLittleEndian((uint32_t) Poly::BLOCK_SIZE);
+    header.count = toLittleEndian(this->written);
+    return this->file != nullptr and std::fwrite(&header, sizeof(header), 1, this->file) == 1;
+}
+
+bool PolyCorpusWriter::writeZeros(uint64_t n) {
+    static const char zeros[ALIGNMENT] = {0};
+    return n == 0 or (this->file != nullptr and std::fwrite(zeros, 1, n, this->file) == n);
+}
+
+/*****************************************************************************\
+|*                              PolyCorpusReader                             *|
+\*****************************************************************************/
+
+PolyCorpusReader::PolyCorpusReader() : mapped(nullptr), fileSize(0), count(0) {
+}
+
+PolyCorpusReader::~PolyCorpusReader() {
+    this->close();
+}
+
+bool PolyCorpusReader::open(const std::string& path) {
+    this->close();
+
+    // The views use the blocks as they are, in the order of the host
+    if (not isLittleEndian()) {
+        return false;
+    }
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 or (uint64_t) st.st_size < sizeof(PolyCorpusHeader)) {
+        ::close(fd);
+        return false;
+    }
+
+    void* address = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (address == MAP_FAILED) {
+        return false;
+    }
+    madvise(address, st.st_size, MADV_SEQUENTIAL);
+
+    this->mapped = static_cast<const char*>(address);
+    this->fileSize = st.st_size;
+
+    const PolyCorpusHeader* header = reinterpret_cast<const PolyCorpusHeader*>(this->mapped);
+    if (std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 or header->version != VERSION or
+            header->blockSize != Poly::BLOCK_SIZE) {
+        this->close();
+        return false;
+    }
+    this->count = header->count;
+
+    return true;
+}
+
+void PolyCorpusReader::close() {
+    if (this->mapped != nullptr) {
+        munmap(const_cast<char*>(this->mapped), this->fileSize);
+    }
+    this->mapped = nullptr;
+    this->fileSize = 0;
+    this->count = 0;
+}
+
+uint64_t PolyCorpusReader::size() const {
+    return this->count;
+}
+
+PolyCorpusReader::Iterator PolyCorpusReader::begin() const {
+    return Iterator(this, 0, nextBlocksOffset(sizeof(PolyCorpusHeader)));
+}
+
+PolyCorpusReader::Iterator PolyCorpusReader::end() const {
+    return Iterator(this, this->count, 0);
+}
+
+PolyCorpusReader::Iterator::Iterator(const PolyCorpusReader* reader, uint64_t index, uint64_t offset)
+    : reader(reader), index(index), offset(offset) {
+    this->load();
+}
+
+const Poly& PolyCorpusReader::Iterator::operator*() const {
+    return this->view.poly();
+}
+
+const Poly* PolyCorpusReader::Iterator::operator->() const {
+    return &this->view.poly();
+}
+
+PolyCorpusReader::Iterator& PolyCorpusReader::Iterator::operator++() {
+    uint64_t end = this->offset + this->view.poly().numUsedBlocks() * sizeof(Poly::Block);
+    this->offset = nextBlocksOffset(end);
+    this->index ++;
+    this->load();
+    return *this;
+}
+
+bool PolyCorpusReader::Iterator::operator!=(const Iterator& other) const {
+    return this->index != other.index;
+}
+
+void PolyCorpusReader::Iterator::load() {
+    if (this->index >= this->reader->count) {
+        return;
+    }
+
+    // A record that doesn't fit in the file ends the iteration
+    if (this->offset > this->reader->fileSize) {
+        this->index = this->reader->count;
+        return;
+    }
+    int64_t degree;
+    std::memcpy(&degree, this->reader->mapped + this->offset - sizeof(int64_t), sizeof(degree));
+    if (degree < -1 or degree > INT32_MAX or
+            this->offset + numBlocksOf(degree) * sizeof(Poly::Block) > this->reader->fileSize) {
+        this->index = this->reader->count;
+        return;
+    }
+
+    // So is one whose top block doesn't have its top bit at the degree
+    const Poly::Block* blocks = reinterpret_cast<const Poly::Block*>(this->reader->mapped + this->offset);
+    if (degree >= 0 and (blocks[degree / Poly::BLOCK_SIZE] >> (degree % Poly::BLOCK_SIZE)) != 1) {
+        this->index = this->reader->count;
+        return;
+    }
+
+    this->view.reset(blocks, degree);
+}
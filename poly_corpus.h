@@ -0,0 +1,118 @@
+#ifndef POLY_CORPUS_H
+#define POLY_CORPUS_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "poly.h"
+
+// Binary files of polys, meant to be mapped and read in place. A file is a
+// 64 byte header then one record per poly: its degree as an int64 then its
+// blocks. The blocks of each record start on a multiple of 64 bytes with
+// the degree in the 8 bytes before them, the padding is 0 and everything is
+// little-endian. The bits of the top block above the degree are 0, as in a
+// Poly, so the blocks can be used as they are.
+struct PolyCorpusHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t blockSize;
+    uint64_t count;
+    uint8_t reserved[40];
+};
+
+static_assert(sizeof(PolyCorpusHeader) == 64, "The corpus header must be 64 bytes");
+
+// A Poly reading blocks it doesn't own, like the ones of a mapped file. The
+// blocks must outlive the view and are never written: the Poly is only
+// given out as a const Poly&, copying it gives an owning Poly.
+class PolyView {
+    public:
+        PolyView();
+        PolyView(const Poly::Block* blocks, int degree);
+        PolyView(const PolyView& other);
+        ~PolyView();
+
+        PolyView& operator=(const PolyView& other);
+
+        // blocks holds the degree / 64 + 1 blocks of the poly
+        void reset(const Poly::Block* blocks, int degree);
+        const Poly& poly() const;
+
+    private:
+        Poly view;
+};
+
+class PolyCorpusWriter {
+    public:
+        PolyCorpusWriter();
+        // Closes the file if it is still open
+        ~PolyCorpusWriter();
+
+        PolyCorpusWriter(const PolyCorpusWriter&) = delete;
+        PolyCorpusWriter& operator=(const PolyCorpusWriter&) = delete;
+
+        // These return false when the file can't be written, write and close
+        // also when no file is open
+        bool open(const std::string& path);
+        bool write(const Poly& p);
+        // Writes the number of polys in the header
+        bool close();
+
+        uint64_t count() const;
+
+    private:
+        bool writeHeader();
+        bool writeZeros(uint64_t n);
+
+        std::FILE* file;
+        uint64_t written;
+        uint64_t offset;
+};
+
+// Maps a corpus and iterates over views of its polys, nothing is copied or
+// parsed past the header. A record that goes past the end of a truncated
+// file, or whose top block doesn't match its degree, ends the iteration.
+class PolyCorpusReader {
+    public:
+        class Iterator {
+            public:
+                const Poly& operator*() const;
+                const Poly* operator->() const;
+                Iterator& operator++();
+                bool operator!=(const Iterator& other) const;
+
+            private:
+                friend class PolyCorpusReader;
+
+                Iterator(const PolyCorpusReader* reader, uint64_t index, uint64_t offset);
+                // Points the view at the record whose blocks are at offset
+                void load();
+
+                const PolyCorpusReader* reader;
+                uint64_t index;
+                uint64_t offset;
+                PolyView view;
+        };
+
+        PolyCorpusReader();
+        ~PolyCorpusReader();
+
+        PolyCorpusReader(const PolyCorpusReader&) = delete;
+        PolyCorpusReader& operator=(const PolyCorpusReader&) = delete;
+
+        // Returns false when the file can't be mapped or isn't a corpus
+        bool open(const std::string& path);
+        void close();
+
+        uint64_t size() const;
+        Iterator begin() const;
+        Iterator end() const;
+
+    private:
+        const char* mapped;
+        uint64_t fileSize;
+        uint64_t count;
+};
+
+#endif //POLY_CORPUS_H
@@ -0,0 +1,159 @@
+#include <algorithm>
+#include <random>
+
+#include "poly_factor.h"
+#include "poly_modulus.h"
+
+// Number of degrees whose gcds are merged into one by the distinct degree
+// factorization
+static constexpr unsigned DISTINCT_DEGREE_BATCH = 32;
+
+static Poly exactQuotient(const Poly& a, const Poly& b) {
+    Poly q, r;
+    a.euclidianDivision(b, q, r);
+    return q;
+}
+
+// The squarefree factorization algorithm for finite fields: c = gcd(f, f')
+// holds the repeated factors, the factors of multiplicity i are peeled off
+// one multiplicity at a time. What is left in c has a zero derivative, so in
+// characteristic 2 it is a square and its root is decomposed recursively.
+std::vector<PolyFactor> squarefreeDecomposition(const Poly& f) {
+    std::vector<PolyFactor> res;
+
+    Poly c = f.gcd(f.derivative());
+    Poly w = exactQuotient(f, c);
+
+    for (unsigned i = 1; w.degree() > 0; i++) {
+        Poly y = w.gcd(c);
+        Poly factor = exactQuotient(w, y);
+        if (factor.degree() > 0) {
+            res.push_back({std::move(factor), i});
+        }
+        c = exactQuotient(c, y);
+        w = std::move(y);
+    }
+
+    if (c.degree() > 0) {
+        for (PolyFactor& root : squarefreeDecomposition(c.squareRoot())) {
+            root.multiplicity *= 2;
+            res.push_back(std::move(root));
+        }
+    }
+
+    return res;
+}
+
+// x^(2^d) - x is the product of the irreducible polys of degree dividing d,
+// so gcd(x^(2^d) - x, f) is the product of the factors of degree d once the
+// smaller ones are removed. To save gcds the x^(2^d) - x of consecutive
+// degrees are multiplied together modulo f and the gcd with their product
+// only gets split when it isn't 1. Once d goes past half the degree of what
+// is left, that is irreducible.
+std::vector<DistinctDegreeFactor> distinctDegreeFactorization(const Poly& f) {
+    std::vector<DistinctDegreeFactor> res;
+    Poly rest = f;
+    Poly x = Poly::fromInt(2);
+
+    PolyModulus modulus(rest);
+    Poly power = x;
+    modulus.reduce(power);
+
+    std::vector<Poly> batch;
+    Poly product = Poly::fromInt(1);
+    unsigned batchStart = 1;
+
+    for (unsigned d = 1; 2 * d <= (unsigned) rest.degree(); d++) {
+        modulus.sqrmod(power, power);
+        batch.push_back(power + x);
+        modulus.mulmod(product, batch.back(), product);
+
+        if (batch.size() < DISTINCT_DEGREE_BATCH and 2 * (d + 1) <= (unsigned) rest.degree()) {
+            continue;
+        }
+
+        Poly common = product.gcd(rest);
+        if (common.degree() > 0) {
+            for (unsigned i = 0; i < batch.size() and common.degree() > 0; i++) {
+                Poly factors = batch[i].gcd(common);
+                if (factors.degree() > 0) {
+                    common = exactQuotient(common, factors);
+                    rest = exactQuotient(rest, factors);
+                    res.push_back({std::move(factors), batchStart + i});
+                }
+            }
+
+            modulus = PolyModulus(rest);
+            modulus.reduce(power);
+        }
+
+        batch.clear();
+        product = Poly::fromInt(1);
+        batchStart = d + 1;
+    }
+
+    if (rest.degree() > 0) {
+        unsigned degree = rest.degree();
+        res.push_back({std::move(rest), degree});
+    }
+
+    return res;
+}
+
+// The trace map T(a) = a + a^2 + ... + a^(2^(d-1)) sends each component
+// GF(2^d) of GF(2)[x] / f to GF(2), so for a random a, gcd(T(a), f) is the
+// product of the factors where T(a) is 0, about half of them.
+void equalDegreeFactorization(const Poly& f, unsigned degree, std::vector<Poly>& factors) {
+    if ((unsigned) f.degree() <= degree) {
+        factors.push_back(f);
+        return;
+    }
+
+    static thread_local std::default_random_engine generator;
+    PolyModulus modulus(f);
+
+    while (true) {
+        Poly a = Poly::random(f.degree() - 1, generator);
+        Poly trace = a;
+        for (unsigned i = 1; i < degree; i++) {
+            modulus.sqrmod(a, a);
+            trace += a;
+        }
+
+        Poly split = trace.gcd(f);
+        if (split.degree() > 0 and split.degree() < f.degree()) {
+            equalDegreeFactorization(split, degree, factors);
+            equalDegreeFactorization(exactQuotient(f, split), degree, factors);
+            return;
+        }
+    }
+}
+
+std::vector<PolyFactor> factor(const Poly& f) {
+    std::vector<PolyFactor> res;
+    std::vector<Poly> factors;
+
+    for (const PolyFactor& squarefree : squarefreeDecomposition(f)) {
+        for (const DistinctDegreeFactor& sameDegree : distinctDegreeFactorization(squarefree.poly)) {
+            factors.clear();
+            equalDegreeFactorization(sameDegree.poly, sameDegree.degree, factors);
+            for (Poly& irreducible : factors) {
+                res.push_back({std::move(irreducible), squarefree.multiplicity});
+            }
+        }
+    }
+
+    std::stable_sort(res.begin(), res.end(), [](const PolyFactor& a, const PolyFactor& b) {
+        return a.poly.degree() < b.poly.degree();
+    });
+    return res;
+}
+
+std::vector<std::vector<PolyFactor>> factorBatch(const std::vector<Poly>& polys) {
+    std::vector<std::vector<PolyFactor>> res;
+    res.reserve(polys.size());
+    for (const Poly& p : polys) {
+        res.push_back(factor(p));
+    }
+    return res;
+}
@@ -0,0 +1,44 @@
+#ifndef POLY_FACTOR_H
+#define POLY_FACTOR_H
+
+#include <vector>
+
+#include "poly.h"
+
+// Factorization over Z/2Z in the usual three steps, each usable on its own:
+//  - the squarefree decomposition splits f into squarefree coprime polys,
+//  - the distinct degree factorization splits a squarefree poly into the
+//    products of its irreducible factors of each degree,
+//  - the equal degree factorization splits such a product into its factors.
+// The last step is randomized.
+
+struct PolyFactor {
+    Poly poly;
+    unsigned multiplicity;
+};
+
+struct DistinctDegreeFactor {
+    Poly poly;
+    // The degree of each irreducible factor of poly
+    unsigned degree;
+};
+
+// f is the product of the poly^multiplicity, the polys are squarefree,
+// coprime and there is at most one per multiplicity. f must not be 0.
+std::vector<PolyFactor> squarefreeDecomposition(const Poly& f);
+
+// f must be squarefree
+std::vector<DistinctDegreeFactor> distinctDegreeFactorization(const Poly& f);
+
+// f must be a product of distinct irreducible polys of the given degree,
+// they are appended to factors
+void equalDegreeFactorization(const Poly& f, unsigned degree, std::vector<Poly>& factors);
+
+// The irreducible factors of f with their multiplicity, by increasing degree.
+// f must not be 0.
+std::vector<PolyFactor> factor(const Poly& f);
+
+// factor() on each poly
+std::vector<std::vector<PolyFactor>> factorBatch(const std::vector<Poly>& polys);
+
+#endif //POLY_FACTOR_H
@@ -0,0 +1,277 @@
+#include <algorithm>
+#include <utility>
+
+#include "poly.h"
+#include "bit_utils.h"
+#include "poly_stats.h"
+
+// Measured on a CLMUL machine, the half GCD wins from about 64k bits. When
+// the Bezout coefficients are needed the binary GCD has to accumulate the
+// matrix one block at a time and loses from about 2k bits.
+unsigned Poly::halfGcdThreshold = 1024;
+unsigned Poly::halfExtendedGcdThreshold = 32;
+
+/*****************************************************************************\
+|*                                 Public API                                *|
+\*****************************************************************************/
+
+Poly Poly::gcd(const Poly& other) const {
+    Poly g;
+    this->doExtendedGcd(other, g, nullptr, nullptr);
+    return g;
+}
+
+void Poly::extendedGcd(const Poly& other, Poly& g, Poly& u, Poly& v) const {
+    this->doExtendedGcd(other, g, &u, &v);
+}
+
+/*****************************************************************************\
+|*                                  Divsteps                                 *|
+\*****************************************************************************/
+
+// Both GCDs are built on Bernstein and Yang's divstep on f, g with f odd:
+//  - if delta > 0 and g is odd, (delta, f, g) <- (1 - delta, g, (g + f) / x)
+//  - if g is odd,               (delta, f, g) <- (1 + delta, f, (g + f) / x)
+//  - otherwise                  (delta, f, g) <- (1 + delta, f, g / x)
+// Each step keeps the gcd, g reaches 0 after at most 2 * max(deg(f),
+// deg(g) + 1) steps and f is then the gcd. This is a binary GCD where the
+// degree comparison is replaced by delta: the steps only look at the low bit
+// of g, so n steps only depend on the low n bits of f and g.
+//
+// After n steps x^n (f', g') = M (f, g) where the entries of M have degree
+// at most n. DIVSTEPS steps are done with words, the matrix entries still
+// fitting in a block.
+static constexpr unsigned DIVSTEPS = Poly::BLOCK_SIZE - 1;
+
+// Recursion leaves of the half GCD, in number of DIVSTEPS
+static constexpr unsigned HALF_GCD_BASECASE = 64;
+
+static int divsteps(int delta, Poly::Block f, Poly::Block g, Poly::Block matrix[4]) {
+    Poly::Block u = 1, v = 0, q = 0, r = 1;
+
+    for (unsigned i = 0; i < DIVSTEPS; i++) {
+        if (g & 1) {
+            if (delta > 0) {
+                delta = 1 - delta;
+                Poly::Block oldF = f;
+                f = g;
+                g = (g ^ oldF) >> 1;
+
+                Poly::Block oldU = u, oldV = v;
+                u = q << 1;
+                v = r << 1;
+                q ^= oldU;
+                r ^= oldV;
+            } else {
+                delta = 1 + delta;
+                g = (g ^ f) >> 1;
+                q ^= u;
+                r ^= v;
+                u <<= 1;
+                v <<= 1;
+            }
+        } else {
+            delta = 1 + delta;
+            g >>= 1;
+            u <<= 1;
+            v <<= 1;
+        }
+    }
+
+    matrix[0] = u;
+    matrix[1] = v;
+    matrix[2] = q;
+    matrix[3] = r;
+    return delta;
+}
+
+// this = (u * a + v * b) / x^shift, the division must be exact. this must
+// not be a or b.
+void Poly::setLinearCombination(Block u, const Poly& a, Block v, const Poly& b, unsigned shift) {
+    unsigned aNBlocks = a.numUsedBlocks();
+    unsigned bNBlocks = b.numUsedBlocks();
+    unsigned nBlocks = std::max(aNBlocks, bNBlocks) + 1;
+    unsigned previousUsed = this->prepareBlocks(nBlocks);
+    Block* res = this->data();
+    const Block* aBlocks = a.data();
+    const Block* bBlocks = b.data();
+
+    for (unsigned i = 0; i < nBlocks; i++) {
+        res[i] = 0;
+    }
+
+    Block high, low;
+    for (unsigned i = 0; i < aNBlocks; i++) {
+        fast_convolution_64_128(u, aBlocks[i], high, low);
+        res[i] ^= low;
+        res[i + 1] ^= high;
+    }
+    for (unsigned i = 0; i < bNBlocks; i++) {
+        fast_convolution_64_128(v, bBlocks[i], high, low);
+        res[i] ^= low;
+        res[i + 1] ^= high;
+    }
+
+    if (shift != 0) {
+        for (unsigned i = 0; i + 1 < nBlocks; i++) {
+            res[i] = (res[i] >> shift) | (res[i + 1] << (BLOCK_SIZE - shift));
+        }
+        res[nBlocks - 1] >>= shift;
+    }
+
+    this->finishBlocks(nBlocks, previousUsed);
+}
+
+// The product of the divstep matrices, x^n (f', g') = M (f, g)
+struct PolyMatrix {
+    Poly m00, m01, m10, m11;
+
+    PolyMatrix() : m00(Poly::fromInt(1)), m11(Poly::fromInt(1)) {
+    }
+
+    PolyMatrix operator*(const PolyMatrix& other) const {
+        PolyMatrix res;
+        res.m00 = this->m00 * other.m00 + this->m01 * other.m10;
+        res.m01 = this->m00 * other.m01 + this->m01 * other.m11;
+        res.m10 = this->m10 * other.m00 + this->m11 * other.m10;
+        res.m11 = this->m10 * other.m01 + this->m11 * other.m11;
+        return res;
+    }
+
+    // M = (u v; q r) M for the matrix of DIVSTEPS steps
+    void leftMultiply(const Poly::Block matrix[4], Poly tmp[4]) {
+        tmp[0].setLinearCombination(matrix[0], this->m00, matrix[1], this->m10, 0);
+        tmp[1].setLinearCombination(matrix[0], this->m01, matrix[1], this->m11, 0);
+        tmp[2].setLinearCombination(matrix[2], this->m00, matrix[3], this->m10, 0);
+        tmp[3].setLinearCombination(matrix[2], this->m01, matrix[3], this->m11, 0);
+        std::swap(this->m00, tmp[0]);
+        std::swap(this->m01, tmp[1]);
+        std::swap(this->m10, tmp[2]);
+        std::swap(this->m11, tmp[3]);
+    }
+
+    // Runs DIVSTEPS at a time on f and g in place. It stops after nSteps
+    // or, when nSteps is 0, once g is 0. Returns the number of steps done.
+    static unsigned iterate(unsigned nSteps, int& delta, Poly& f, Poly& g, PolyMatrix* res) {
+        Poly tmp[4];
+        unsigned steps = 0;
+
+        while (nSteps == 0 ? g.size() != 0 : steps < nSteps) {
+            Poly::Block matrix[4];
+            POLY_COUNT(DIVSTEPS_CHUNKS);
+            delta = divsteps(delta, f.block(0), g.block(0), matrix);
+
+            tmp[0].setLinearCombination(matrix[0], f, matrix[1], g, DIVSTEPS);
+            tmp[1].setLinearCombination(matrix[2], f, matrix[3], g, DIVSTEPS);
+            std::swap(f, tmp[0]);
+            std::swap(g, tmp[1]);
+            if (res != nullptr) {
+                res->leftMultiply(matrix, tmp);
+            }
+            steps += DIVSTEPS;
+        }
+        return steps;
+    }
+
+    // The half GCD: the matrix of nSteps steps, a multiple of DIVSTEPS, is
+    // the product of the matrices of two halves. The first half only needs
+    // the low bits of f and g and the second half the low bits of the
+    // result of the first, so each half is a recursive call on operands
+    // truncated to its number of steps, the work being in multiplications.
+    static PolyMatrix recurse(unsigned nSteps, int& delta, Poly f, Poly g) {
+        f.truncate(nSteps);
+        g.truncate(nSteps);
+
+        PolyMatrix res;
+        if (nSteps <= HALF_GCD_BASECASE * DIVSTEPS) {
+            iterate(nSteps, delta, f, g, &res);
+            return res;
+        }
+
+        unsigned half = nSteps / DIVSTEPS / 2 * DIVSTEPS;
+        PolyMatrix low = recurse(half, delta, f, g);
+
+        Poly fHigh, gHigh;
+        (low.m00 * f + low.m01 * g).shiftRight(half, fHigh);
+        (low.m10 * f + low.m11 * g).shiftRight(half, gHigh);
+        PolyMatrix high = recurse(nSteps - half, delta, std::move(fHigh), std::move(gHigh));
+
+        return high * low;
+    }
+};
+
+/*****************************************************************************\
+|*                                     GCD                                   *|
+\*****************************************************************************/
+
+// The common power of x is taken out then divsteps run with f the odd
+// operand, h the other one. Small operands iterate until h is 0, big ones
+// use the half GCD on the step count bound. With (mu mv) the top row of the
+// matrix of the N steps, x^N gcd = mu f + mv h so the Bezout coefficient of
+// h is mv / x^N modulo f / gcd, computed as a Montgomery reduction, and the
+// one of f comes from an exact division.
+void Poly::doExtendedGcd(const Poly& other, Poly& g, Poly* u, Poly* v) const {
+    POLY_TIME(GCD_TIME);
+    bool extended = u != nullptr;
+
+    if (this->size() == 0 or other.size() == 0) {
+        bool thisIsZero = this->size() == 0;
+        g = thisIsZero ? other : *this;
+        if (extended) {
+            u->setToBlock(thisIsZero ? 0 : 1);
+            v->setToBlock(thisIsZero ? 1 : 0);
+        }
+        return;
+    }
+
+    unsigned thisZeros = 0, otherZeros = 0;
+    while (not this->bit(thisZeros)) {
+        thisZeros ++;
+    }
+    while (not other.bit(otherZeros)) {
+        otherZeros ++;
+    }
+    unsigned commonZeros = std::min(thisZeros, otherZeros);
+
+    bool swapped = thisZeros != commonZeros;
+    Poly fStart, hStart;
+    (swapped ? other : *this).shiftRight(commonZeros, fStart);
+    (swapped ? *this : other).shiftRight(commonZeros, hStart);
+
+    Poly f = fStart, h = hStart, mv;
+    unsigned nSteps;
+    int delta = 1;
+    unsigned threshold = extended ? halfExtendedGcdThreshold : halfGcdThreshold;
+    if (std::max(f.numUsedBlocks(), h.numUsedBlocks()) < threshold) {
+        PolyMatrix m;
+        nSteps = PolyMatrix::iterate(0, delta, f, h, extended ? &m : nullptr);
+        mv = std::move(m.m01);
+    } else {
+        unsigned bound = 2 * std::max(f.degree(), h.degree() + 1);
+        nSteps = (bound + DIVSTEPS - 1) / DIVSTEPS * DIVSTEPS;
+        PolyMatrix m = PolyMatrix::recurse(nSteps, delta, f, h);
+        (m.m00 * fStart + m.m01 * hStart).shiftRight(nSteps, f);
+        mv = std::move(m.m01);
+    }
+
+    f.shiftLeft(commonZeros, g);
+
+    if (not extended) {
+        return;
+    }
+
+    // fStart / gcd is odd so x is invertible modulo it
+    Poly cofactor, remainder, hCoefficient, fCoefficient, multiple, inverse;
+    fStart.euclidianDivision(f, cofactor, remainder);
+    mv.euclidianDivision(cofactor, multiple, hCoefficient);
+
+    cofactor.inverseSeries(nSteps, inverse);
+    multiple = hCoefficient * inverse;
+    multiple.truncate(nSteps);
+    (hCoefficient + multiple * cofactor).shiftRight(nSteps, hCoefficient);
+
+    (f + hCoefficient * hStart).euclidianDivision(fStart, fCoefficient, remainder);
+
+    *u = swapped ? hCoefficient : fCoefficient;
+    *v = swapped ? fCoefficient : hCoefficient;
+}
@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include "poly_irreducible.h"
+#include "poly_modulus.h"
+
+// Factors up to that degree are found with a gcd with their product
+static constexpr unsigned TRIAL_DEGREE = 8;
+
+// After that many iterations the gcds of several x^(2^i) - x are merged by
+// multiplying them modulo f, factors of high degree being rare
+static constexpr unsigned BEN_OR_SINGLE_GCDS = 32;
+static constexpr unsigned BEN_OR_BATCH = 8;
+
+// The product of the irreducible polys of degree 2 to TRIAL_DEGREE, found
+// by trial division by the smaller ones
+static Poly smallIrreducibleProduct() {
+    std::vector<Poly> irreducibles;
+    Poly product = Poly::fromInt(1);
+
+    for (Poly::Block value = 2; value < ((Poly::Block) 2) << TRIAL_DEGREE; value++) {
+        Poly p = Poly::fromInt(value);
+        bool irreducible = true;
+        for (const Poly& divisor : irreducibles) {
+            if (2 * divisor.degree() > p.degree()) {
+                break;
+            }
+            Poly q, r;
+            p.euclidianDivision(divisor, q, r);
+            if (r.size() == 0) {
+                irreducible = false;
+                break;
+            }
+        }
+
+        if (irreducible) {
+            irreducibles.push_back(p);
+            if (p.degree() > 1) {
+                product *= p;
+            }
+        }
+    }
+
+    return product;
+}
+
+bool isIrreducible(const Poly& f) {
+    int n = f.degree();
+    if (n <= 1) {
+        return n == 1;
+    }
+
+    // x and x + 1, f(0) = 0 or f(1) = 0
+    unsigned weight = 0;
+    for (unsigned i = 0; i < f.numUsedBlocks(); i++) {
+        weight += __builtin_popcountll(f.block(i));
+    }
+    if (f.bit(0) == 0 or weight % 2 == 0) {
+        return false;
+    }
+
+    bool trialDone = n > (int) TRIAL_DEGREE;
+    if (trialDone) {
+        static const PolyModulus smallIrreducibles(smallIrreducibleProduct());
+        Poly reduced = f;
+        smallIrreducibles.reduce(reduced);
+        if (reduced.gcd(smallIrreducibles.modulus()).degree() > 0) {
+            return false;
+        }
+    }
+
+    PolyModulus modulus(f);
+    Poly x = Poly::fromInt(2);
+    Poly power = x;
+    Poly product = Poly::fromInt(1);
+    unsigned batched = 0;
+
+    for (int i = 1; 2 * i <= n; i++) {
+        modulus.sqrmod(power, power);
+        if (trialDone and i <= (int) TRIAL_DEGREE) {
+            continue;
+        }
+
+        modulus.mulmod(product, power + x, product);
+        batched ++;
+
+        bool last = 2 * (i + 1) > n;
+        if (i > (int) BEN_OR_SINGLE_GCDS and batched < BEN_OR_BATCH and not last) {
+            continue;
+        }
+
+        if (product.gcd(f).degree() > 0) {
+            return false;
+        }
+        product = Poly::fromInt(1);
+        batched = 0;
+    }
+
+    return true;
+}
+
+// The candidates are taken in order from a shared counter. Once enough are
+// found no new candidate is taken, the ones being tested are finished so
+// all the candidates before the last one taken have been tested.
+std::vector<Poly> findIrreducibles(const std::vector<Poly>& candidates, unsigned count, unsigned nThreads) {
+    if (nThreads == 0) {
+        nThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    std::vector<char> irreducible(candidates.size(), 0);
+    std::atomic<unsigned> next(0);
+    std::atomic<unsigned> found(0);
+
+    auto worker = [&]() {
+        while (found.load() < count) {
+            unsigned i = next.fetch_add(1);
+            if (i >= candidates.size()) {
+                return;
+            }
+            if (isIrreducible(candidates[i])) {
+                irreducible[i] = 1;
+                found.fetch_add(1);
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < nThreads; i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    std::vector<Poly> res;
+    for (unsigned i = 0; i < candidates.size() and res.size() < count; i++) {
+        if (irreducible[i]) {
+            res.push_back(candidates[i]);
+        }
+    }
+    return res;
+}
@@ -0,0 +1,20 @@
+#ifndef POLY_IRREDUCIBLE_H
+#define POLY_IRREDUCIBLE_H
+
+#include <vector>
+
+#include "poly.h"
+
+// Ben-Or's irreducibility test: f of degree n is irreducible iff
+// gcd(x^(2^i) - x, f) = 1 for i up to n / 2. Random polys mostly have a small
+// factor, so the factors of degree 1 are looked for with the bits of f and
+// the ones of degree up to 8 with a single gcd before the x^(2^i) are
+// iterated, stopping at the first common factor.
+bool isIrreducible(const Poly& f);
+
+// Tests the candidates on nThreads threads, 0 meaning one per core, and
+// stops once count irreducible polys are found. Returns the first count
+// irreducible candidates, in the order of candidates.
+std::vector<Poly> findIrreducibles(const std::vector<Poly>& candidates, unsigned count, unsigned nThreads = 0);
+
+#endif //POLY_IRREDUCIBLE_H
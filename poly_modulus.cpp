@@ -0,0 +1,159 @@
+#include <algorithm>
+
+#include "poly_modulus.h"
+#include "bit_utils.h"
+
+PolyModulus::PolyModulus(const Poly& f) : f(f) {
+    int m = f.degree();
+
+    unsigned weight = 0;
+    for (unsigned i = 0; i < f.numUsedBlocks(); i++) {
+        weight += __builtin_popcountll(f.block(i));
+    }
+    if (weight == 3 or weight == 5) {
+        for (int i = 0; i < m; i++) {
+            if (f.bit(i)) {
+                lowTerms.push_back(i);
+            }
+        }
+    }
+
+    this->topReciprocal = f.topBlockReciprocal();
+
+    if (not lowTerms.empty() and m - (int) lowTerms.back() >= (int) Poly::BLOCK_SIZE) {
+        this->method = Reduction::SPARSE;
+    } else if (f.numUsedBlocks() >= Poly::newtonDivisionThreshold) {
+        this->method = Reduction::BARRETT;
+        Poly fReversed;
+        f.reverse(m + 1, fReversed);
+        fReversed.inverseSeries(m - 1, this->inverse);
+    } else {
+        this->method = Reduction::BLOCKS;
+    }
+}
+
+const Poly& PolyModulus::modulus() const {
+    return this->f;
+}
+
+int PolyModulus::degree() const {
+    return this->f.degree();
+}
+
+PolyModulus::Reduction PolyModulus::reduction() const {
+    return this->method;
+}
+
+void PolyModulus::reduce(Poly& p) const {
+    int m = this->f.degree();
+    if (p.degree() < m) {
+        return;
+    }
+
+    if (this->method == Reduction::SPARSE) {
+        this->reduceSparse(p);
+    } else if (this->method == Reduction::BARRETT and p.degree() <= 2 * m - 2) {
+        this->reduceBarrett(p);
+    } else {
+        p.reduceBlocks(this->f, this->topReciprocal, nullptr);
+    }
+}
+
+void PolyModulus::mulmod(const Poly& a, const Poly& b, Poly& res) const {
+    a.multiply(b, res);
+    this->reduce(res);
+}
+
+void PolyModulus::sqrmod(const Poly& a, Poly& res) const {
+    a.square(res);
+    this->reduce(res);
+}
+
+// Left to right square and multiply
+void PolyModulus::powmod(const Poly& a, uint64_t e, Poly& res) const {
+    Poly base = a;
+    res.setToBlock(1);
+    this->reduce(res);
+
+    for (int i = e == 0 ? -1 : log2_u64(e); i >= 0; i--) {
+        this->sqrmod(res, res);
+        if ((e >> i) & 1) {
+            this->mulmod(res, base, res);
+        }
+    }
+}
+
+Poly PolyModulus::mulmod(const Poly& a, const Poly& b) const {
+    Poly res;
+    this->mulmod(a, b, res);
+    return res;
+}
+
+Poly PolyModulus::sqrmod(const Poly& a) const {
+    Poly res;
+    this->sqrmod(a, res);
+    return res;
+}
+
+Poly PolyModulus::powmod(const Poly& a, uint64_t e) const {
+    Poly res;
+    this->powmod(a, e, res);
+    return res;
+}
+
+// x^m = sum of the low terms mod f, so the bits at or above m are folded a
+// block at a time from the top. The low terms being at least a block below
+// m, a block only gets folded into the blocks under it.
+void PolyModulus::reduceSparse(Poly& p) const {
+    const unsigned BLOCK_SIZE = Poly::BLOCK_SIZE;
+    unsigned m = this->f.degree();
+    unsigned mBlock = m / BLOCK_SIZE;
+    unsigned nBlocks = p.numUsedBlocks();
+    Block* blocks = p.data();
+
+    for (unsigned i = nBlocks; i-->mBlock;) {
+        Block value = blocks[i];
+        if (i == mBlock) {
+            value &= ~((((Block) 1) << (m % BLOCK_SIZE)) - 1);
+        }
+        if (value == 0) {
+            continue;
+        }
+        blocks[i] ^= value;
+
+        // value is now the coefficients of x^(m + offset) and up
+        unsigned offset = 0;
+        if (i == mBlock) {
+            value >>= m % BLOCK_SIZE;
+        } else {
+            offset = i * BLOCK_SIZE - m;
+        }
+
+        for (unsigned term : this->lowTerms) {
+            unsigned position = offset + term;
+            blocks[position / BLOCK_SIZE] ^= value << (position % BLOCK_SIZE);
+            if (position % BLOCK_SIZE != 0) {
+                blocks[position / BLOCK_SIZE + 1] ^= value >> (BLOCK_SIZE - position % BLOCK_SIZE);
+            }
+        }
+    }
+
+    p.computeDegreeFrom(std::min(nBlocks, mBlock + 1));
+}
+
+// With p of degree at most 2m - 2, the quotient has degree at most m - 2 and
+// rev_(m-2)(q) = rev_(2m-2)(p) / rev_m(f) mod x^(m-1), see
+// Poly::doDivideNewton.
+void PolyModulus::reduceBarrett(Poly& p) const {
+    unsigned m = this->f.degree();
+
+    Poly pReversed, qReversed, q, qf;
+    p.reverse(2 * m - 1, pReversed);
+    pReversed.truncate(m - 1);
+    pReversed.multiply(this->inverse, qReversed);
+    qReversed.truncate(m - 1);
+    qReversed.reverse(m - 1, q);
+
+    q.multiply(this->f, qf);
+    p += qf;
+}
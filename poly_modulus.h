@@ -0,0 +1,63 @@
+#ifndef POLY_MODULUS_H
+#define POLY_MODULUS_H
+
+#include <cstdint>
+#include <vector>
+
+#include "poly.h"
+
+// Arithmetic modulo a fixed polynomial f. Everything the reduction needs is
+// computed once in the constructor and the reduction itself is picked from
+// the shape of f:
+//  - trinomials and pentanomials whose other terms are at least a block
+//    below the leading one are folded in place a block at a time,
+//  - big moduli use Barrett reduction with the inverse of the reversed f,
+//  - the others use the block division with the reciprocal of the top of f.
+// The operands of mulmod, sqrmod and powmod must already be reduced. res can
+// be one of the operands. A PolyModulus is only read after its construction
+// so it can be shared between threads.
+class PolyModulus {
+    public:
+        typedef Poly::Block Block;
+
+        enum class Reduction {
+            SPARSE,
+            BARRETT,
+            BLOCKS,
+        };
+
+        // f must not be 0
+        explicit PolyModulus(const Poly& f);
+
+        const Poly& modulus() const;
+        int degree() const;
+        Reduction reduction() const;
+
+        // p = p mod f, p can be of any size
+        void reduce(Poly& p) const;
+
+        void mulmod(const Poly& a, const Poly& b, Poly& res) const;
+        void sqrmod(const Poly& a, Poly& res) const;
+        void powmod(const Poly& a, uint64_t e, Poly& res) const;
+
+        Poly mulmod(const Poly& a, const Poly& b) const;
+        Poly sqrmod(const Poly& a) const;
+        Poly powmod(const Poly& a, uint64_t e) const;
+
+    private:
+        void reduceSparse(Poly& p) const;
+        void reduceBarrett(Poly& p) const;
+
+        Poly f;
+        Reduction method;
+
+        // Exponents of the terms of f below the leading one, for SPARSE
+        std::vector<unsigned> lowTerms;
+        // 1 / rev(f) mod x^(deg(f) - 1), for BARRETT
+        Poly inverse;
+        // f.topBlockReciprocal(), for BLOCKS and the reductions of products
+        // too big for Barrett
+        Block topReciprocal;
+};
+
+#endif //POLY_MODULUS_H
@@ -0,0 +1,299 @@
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+#include "poly_sparse.h"
+#include "bit_utils.h"
+
+SparsePoly::SparsePoly() {
+}
+
+SparsePoly::SparsePoly(std::vector<Exponent> exponents) : terms(std::move(exponents)) {
+    this->normalize();
+}
+
+SparsePoly::SparsePoly(std::initializer_list<Exponent> exponents) : terms(exponents) {
+    this->normalize();
+}
+
+SparsePoly SparsePoly::monomial(Exponent e) {
+    SparsePoly res;
+    res.terms.push_back(e);
+    res.prepareReduction();
+    return res;
+}
+
+SparsePoly SparsePoly::fromPoly(const Poly& p) {
+    SparsePoly res;
+    for (unsigned i = 0; i < p.numUsedBlocks(); i++) {
+        for (Poly::Block b = p.block(i); b != 0; b &= b - 1) {
+            res.terms.push_back((Exponent) i * Poly::BLOCK_SIZE + __builtin_ctzll(b));
+        }
+    }
+    res.prepareReduction();
+    return res;
+}
+
+bool SparsePoly::toPoly(Poly& res) const {
+    int64_t degree = this->degree();
+    if (degree < 0 or degree > INT32_MAX) {
+        res.setToBlock(0);
+        return degree < 0;
+    }
+
+    unsigned nBlocks = degree / Poly::BLOCK_SIZE + 1;
+    unsigned previousUsed = res.prepareBlocks(nBlocks);
+    Poly::Block* blocks = res.data();
+    for (unsigned i = 0; i < nBlocks; i++) {
+        blocks[i] = 0;
+    }
+    for (Exponent e : this->terms) {
+        blocks[e / Poly::BLOCK_SIZE] |= ((Poly::Block) 1) << (e % Poly::BLOCK_SIZE);
+    }
+    res.finishBlocks(nBlocks, previousUsed, degree);
+    return true;
+}
+
+Poly SparsePoly::toPoly() const {
+    Poly res;
+    this->toPoly(res);
+    return res;
+}
+
+const std::vector<SparsePoly::Exponent>& SparsePoly::exponents() const {
+    return this->terms;
+}
+
+int64_t SparsePoly::degree() const {
+    return this->terms.empty() ? -1 : (int64_t) this->terms.back();
+}
+
+unsigned SparsePoly::weight() const {
+    return this->terms.size();
+}
+
+bool SparsePoly::isZero() const {
+    return this->terms.empty();
+}
+
+bool SparsePoly::operator==(const SparsePoly& other) const {
+    return this->terms == other.terms;
+}
+
+bool SparsePoly::operator!=(const SparsePoly& other) const {
+    return this->terms != other.terms;
+}
+
+// The terms in exactly one of the operands
+SparsePoly SparsePoly::operator+(const SparsePoly& other) const {
+    SparsePoly res;
+    std::set_symmetric_difference(this->terms.begin(), this->terms.end(), other.terms.begin(), other.terms.end(),
+        std::back_inserter(res.terms));
+    res.prepareReduction();
+    return res;
+}
+
+SparsePoly SparsePoly::operator*(const SparsePoly& other) const {
+    SparsePoly res;
+    res.terms.reserve(this->terms.size() * other.terms.size());
+    for (Exponent a : this->terms) {
+        for (Exponent b : other.terms) {
+            res.terms.push_back(a + b);
+        }
+    }
+    res.normalize();
+    return res;
+}
+
+SparsePoly SparsePoly::operator<<(Exponent shift) const {
+    SparsePoly res = *this;
+    for (Exponent& e : res.terms) {
+        e += shift;
+    }
+    res.prepareReduction();
+    return res;
+}
+
+SparsePoly& SparsePoly::operator+=(const SparsePoly& other) {
+    *this = *this + other;
+    return *this;
+}
+
+SparsePoly SparsePoly::powerOfTwo(unsigned k) const {
+    SparsePoly res = *this;
+    for (Exponent& e : res.terms) {
+        e <<= k;
+    }
+    res.prepareReduction();
+    return res;
+}
+
+// The top term goes first so that res is sized once
+void SparsePoly::multiply(const Poly& p, Poly& res) const {
+    if (&res == &p) {
+        Poly copy = p;
+        this->multiply(copy, res);
+        return;
+    }
+
+    res.setToBlock(0);
+    for (unsigned i = this->terms.size(); i-->0;) {
+        res.addShifted(p, this->terms[i]);
+    }
+}
+
+Poly SparsePoly::operator*(const Poly& p) const {
+    Poly res;
+    this->multiply(p, res);
+    return res;
+}
+
+// The len bits of blocks from bit lo, 0 < len <= 64
+static Poly::Block bitsAt(const Poly::Block* blocks, uint64_t lo, unsigned len) {
+    unsigned shift = lo % Poly::BLOCK_SIZE;
+    const Poly::Block* block = blocks + lo / Poly::BLOCK_SIZE;
+    Poly::Block value = block[0] >> shift;
+    if (shift + len > Poly::BLOCK_SIZE) {
+        value |= block[1] << (Poly::BLOCK_SIZE - shift);
+    }
+    return len == Poly::BLOCK_SIZE ? value : value & ((((Poly::Block) 1) << len) - 1);
+}
+
+// blocks ^= value << position, value having len bits
+static void xorBitsAt(Poly::Block* blocks, uint64_t position, Poly::Block value, unsigned len) {
+    unsigned shift = position % Poly::BLOCK_SIZE;
+    Poly::Block* block = blocks + position / Poly::BLOCK_SIZE;
+    block[0] ^= value << shift;
+    if (shift + len > Poly::BLOCK_SIZE) {
+        block[1] ^= value >> (Poly::BLOCK_SIZE - shift);
+    }
+}
+
+// x^m = the low terms mod this, so the bits of p at or above m are folded
+// on the low terms, a block at a time from the top down. A block lands
+// entirely below itself when the second term is at least a block below m,
+// otherwise the block division with the reciprocal of the top of this is
+// used as the folds would only go a few bits at a time.
+void SparsePoly::reduce(Poly& p) const {
+    int m = this->degree();
+    if (p.degree() < m) {
+        return;
+    }
+    if (m == 0) {
+        p.setToBlock(0);
+        return;
+    }
+    if (this->dense.size() != 0) {
+        p.reduceBlocks(this->dense, this->topReciprocal, nullptr);
+        return;
+    }
+
+    unsigned nBlocks = p.numUsedBlocks();
+    Poly::Block* blocks = p.data();
+
+    for (int top = p.degree(); top >= m;) {
+        unsigned len = std::min(Poly::BLOCK_SIZE, (unsigned) (top - m + 1));
+        unsigned lo = top - len + 1;
+        top = lo - 1;
+
+        Poly::Block value = bitsAt(blocks, lo, len);
+        if (value == 0) {
+            continue;
+        }
+        xorBitsAt(blocks, lo, value, len);
+        for (unsigned i = 0; i + 1 < this->terms.size(); i++) {
+            xorBitsAt(blocks, lo - m + this->terms[i], value, len);
+        }
+    }
+
+    p.computeDegreeFrom(std::min(nBlocks, m / Poly::BLOCK_SIZE + 1));
+}
+
+Poly SparsePoly::reduce(const SparsePoly& s) const {
+    Poly res;
+    for (Exponent e : s.terms) {
+        res += this->powerOfXMod(e);
+    }
+    return res;
+}
+
+// Left to right, starting from the longest leading bits of e that are an
+// exponent below m so that x^prefix needs no reduction
+Poly SparsePoly::powerOfXMod(Exponent e) const {
+    Exponent m = this->degree();
+    if (e < m) {
+        return SparsePoly::monomial(e).toPoly();
+    }
+    if (m == 0) {
+        return Poly();
+    }
+
+    int i = log2_u64(e);
+    Exponent prefix = 0;
+    while (i >= 0 and ((prefix << 1) | ((e >> i) & 1)) < m) {
+        prefix = (prefix << 1) | ((e >> i) & 1);
+        i--;
+    }
+
+    Poly res = SparsePoly::monomial(prefix).toPoly();
+    for (; i >= 0; i--) {
+        res.square(res);
+        if ((e >> i) & 1) {
+            res <<= 1;
+        }
+        this->reduce(res);
+    }
+    return res;
+}
+
+void SparsePoly::normalize() {
+    std::sort(this->terms.begin(), this->terms.end());
+
+    unsigned kept = 0;
+    for (unsigned i = 0; i < this->terms.size(); i++) {
+        if (i + 1 < this->terms.size() and this->terms[i] == this->terms[i + 1]) {
+            i++;
+        } else {
+            this->terms[kept++] = this->terms[i];
+        }
+    }
+    this->terms.resize(kept);
+    this->prepareReduction();
+}
+
+void SparsePoly::prepareReduction() {
+    int64_t m = this->degree();
+    Exponent second = this->terms.size() > 1 ? this->terms[this->terms.size() - 2] : 0;
+    if (m > 0 and m <= INT32_MAX and m - second < Poly::BLOCK_SIZE) {
+        this->toPoly(this->dense);
+        this->topReciprocal = this->dense.topBlockReciprocal();
+    } else {
+        this->dense.setToBlock(0);
+        this->topReciprocal = 0;
+    }
+}
+
+Poly operator*(const Poly& p, const SparsePoly& s) {
+    return s * p;
+}
+
+std::ostream& operator<<(std::ostream& os, const SparsePoly& s) {
+    const std::vector<SparsePoly::Exponent>& terms = s.exponents();
+    if (terms.empty()) {
+        return os << "0";
+    }
+
+    for (unsigned i = terms.size(); i-->0;) {
+        if (terms[i] == 0) {
+            os << "1";
+        } else if (terms[i] == 1) {
+            os << "x";
+        } else {
+            os << "x^" << terms[i];
+        }
+        if (i != 0) {
+            os << " + ";
+        }
+    }
+    return os;
+}
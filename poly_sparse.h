@@ -0,0 +1,90 @@
+#ifndef POLY_SPARSE_H
+#define POLY_SPARSE_H
+
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+#include "poly.h"
+
+// A poly stored as the increasing exponents of its nonzero terms, for the
+// trinomials, pentanomials and other polys with few terms. The exponents
+// are 64 bits so the degree can go way past what a Poly holds: x^(2^60) is
+// a single term. The results of the operations must have their exponents
+// fit in 64 bits.
+// A dense poly is multiplied by a sparse one with an addShifted per term
+// and reduced modulo a sparse one by folding the part above the degree on
+// the low terms, without a division.
+class SparsePoly {
+    public:
+        typedef uint64_t Exponent;
+
+        SparsePoly();
+        // The exponents can come in any order, the ones appearing twice
+        // cancel out
+        explicit SparsePoly(std::vector<Exponent> exponents);
+        SparsePoly(std::initializer_list<Exponent> exponents);
+
+        static SparsePoly monomial(Exponent e);
+        static SparsePoly fromPoly(const Poly& p);
+
+        // Returns false and sets res to 0 when the degree doesn't fit in a
+        // Poly
+        bool toPoly(Poly& res) const;
+        // 0 when the degree doesn't fit in a Poly
+        Poly toPoly() const;
+
+        const std::vector<Exponent>& exponents() const;
+        // -1 for 0
+        int64_t degree() const;
+        unsigned weight() const;
+        bool isZero() const;
+
+        bool operator==(const SparsePoly& other) const;
+        bool operator!=(const SparsePoly& other) const;
+
+        SparsePoly operator+(const SparsePoly& other) const;
+        SparsePoly operator*(const SparsePoly& other) const;
+        // Multiplies by x^shift
+        SparsePoly operator<<(Exponent shift) const;
+        SparsePoly& operator+=(const SparsePoly& other);
+
+        // this^(2^k), over GF(2) it is this(x^(2^k)) so the exponents are
+        // only shifted by k
+        SparsePoly powerOfTwo(unsigned k) const;
+
+        // res = p * this with an addShifted of p per term, res can be p.
+        // The degree of the product must fit in a Poly.
+        void multiply(const Poly& p, Poly& res) const;
+        Poly operator*(const Poly& p) const;
+
+        // The reductions modulo this, which must not be 0 and must have its
+        // degree fit in a Poly. p = p mod this, p can be of any size. The
+        // bits are folded a block at a time when the second term is at least
+        // a block below the leading one, else p is divided a block at a time.
+        void reduce(Poly& p) const;
+        // s mod this, term by term with powerOfXMod
+        Poly reduce(const SparsePoly& s) const;
+        // x^e mod this by square and multiply by x, the squares only ever
+        // have twice the degree of this
+        Poly powerOfXMod(Exponent e) const;
+
+    private:
+        // Sorts the exponents and cancels out the pairs
+        void normalize();
+        // Sets dense and topReciprocal from the terms
+        void prepareReduction();
+
+        std::vector<Exponent> terms;
+        // This and the reciprocal of its top block for the block division,
+        // only when the second term is less than a block below the leading
+        // one, 0 otherwise
+        Poly dense;
+        Poly::Block topReciprocal = 0;
+};
+
+Poly operator*(const Poly& p, const SparsePoly& s);
+
+std::ostream& operator<<(std::ostream& os, const SparsePoly& s);
+
+#endif //POLY_SPARSE_H
@@ -0,0 +1,75 @@
+#include "poly_stats.h"
+#include "utils.h"
+
+PolyStats& PolyStats::forThisThread() {
+    static thread_local PolyStats stats;
+    return stats;
+}
+
+const char* PolyStats::counterName(Counter counter) {
+    static const char* names[NUM_COUNTERS] = {
+        "kernel_16",
+        "kernel_32",
+        "kernel_64",
+        "multiply_big",
+        "multiply_fft",
+        "basecase_blocks",
+        "karatsuba_blocks",
+        "toom3_blocks",
+        "temporaries",
+        "heap_allocations",
+        "division_blocks",
+        "newton_steps",
+        "divsteps_chunks",
+        "degree_scans",
+        "degree_scanned_blocks",
+    };
+    return names[counter];
+}
+
+const char* PolyStats::timerName(Timer timer) {
+    static const char* names[NUM_TIMERS] = {
+        "multiply",
+        "division",
+        "gcd",
+    };
+    return names[timer];
+}
+
+void PolyStats::reset() {
+    *this = PolyStats();
+}
+
+void PolyStats::dump(std::ostream& os) const {
+    for (unsigned i = 0; i < NUM_COUNTERS; i++) {
+        os << counterName((Counter) i) << " " << this->counters[i] << std::endl;
+    }
+    os << "max_recursion_depth " << this->maxRecursionDepth << std::endl;
+    for (unsigned i = 0; i < NUM_TIMERS; i++) {
+        os << timerName((Timer) i) << "_calls " << this->timerCalls[i] << std::endl;
+        os << timerName((Timer) i) << "_ns " << this->timerNs[i] << std::endl;
+    }
+}
+
+#if POLY_INSTRUMENTATION
+
+// The timers of a kind running on this thread, only the outermost one counts
+static thread_local unsigned runningTimers[PolyStats::NUM_TIMERS] = {0};
+
+PolyScopedTimer::PolyScopedTimer(PolyStats::Timer timer) : timer(timer), start(0) {
+    this->outermost = runningTimers[timer]++ == 0;
+    if (this->outermost) {
+        this->start = getNanoseconds();
+    }
+}
+
+PolyScopedTimer::~PolyScopedTimer() {
+    runningTimers[this->timer] --;
+    if (this->outermost) {
+        PolyStats& stats = PolyStats::forThisThread();
+        stats.timerNs[this->timer] += getNanoseconds() - this->start;
+        stats.timerCalls[this->timer] ++;
+    }
+}
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef POLY_STATS_H
+#define POLY_STATS_H
+
+#include <cstdint>
+#include <iostream>
+
+// Instrumentation of the hot paths, compiled in with POLY_INSTRUMENTATION=1
+// (the CMake option of the same name). Each thread counts in its own
+// PolyStats, without synchronization, so the counts of a thread are only
+// meaningful when read from that thread. When disabled the macros expand to
+// nothing and the stats stay at 0.
+
+#ifndef POLY_INSTRUMENTATION
+    #define POLY_INSTRUMENTATION 0
+#endif
+
+struct PolyStats {
+    enum Counter {
+        // Leaf kernels and the multiplication algorithms
+        KERNEL_16,
+        KERNEL_32,
+        KERNEL_64,
+        MULTIPLY_BIG,
+        MULTIPLY_FFT,
+        BASECASE_BLOCKS,
+        KARATSUBA_BLOCKS,
+        TOOM3_BLOCKS,
+        // Polys constructed and heap storage allocated for them
+        TEMPORARIES,
+        HEAP_ALLOCATIONS,
+        // Quotient blocks of the block division and Newton steps
+        DIVISION_BLOCKS,
+        NEWTON_STEPS,
+        // Word chunks of divsteps in the GCDs
+        DIVSTEPS_CHUNKS,
+        // Calls to computeDegreeFrom and the blocks it looked at
+        DEGREE_SCANS,
+        DEGREE_SCANNED_BLOCKS,
+        NUM_COUNTERS
+    };
+
+    enum Timer {
+        MULTIPLY_TIME,
+        DIVISION_TIME,
+        GCD_TIME,
+        NUM_TIMERS
+    };
+
+    static constexpr bool enabled = POLY_INSTRUMENTATION;
+
+    uint64_t counters[NUM_COUNTERS] = {0};
+    uint64_t timerNs[NUM_TIMERS] = {0};
+    uint64_t timerCalls[NUM_TIMERS] = {0};
+    // Of the block multiplication recursion
+    unsigned recursionDepth = 0;
+    unsigned maxRecursionDepth = 0;
+
+    static PolyStats& forThisThread();
+    static const char* counterName(Counter counter);
+    static const char* timerName(Timer timer);
+
+    void reset();
+    // One "name value" line per counter and timer
+    void dump(std::ostream& os) const;
+};
+
+#if POLY_INSTRUMENTATION
+
+// Times the enclosing scope, nested timers of the same kind only count once
+class PolyScopedTimer {
+    public:
+        explicit PolyScopedTimer(PolyStats::Timer timer);
+        ~PolyScopedTimer();
+
+    private:
+        PolyStats::Timer timer;
+        long start;
+        bool outermost;
+};
+
+class PolyScopedDepth {
+    public:
+        PolyScopedDepth() {
+            PolyStats& stats = PolyStats::forThisThread();
+            stats.recursionDepth ++;
+            if (stats.recursionDepth > stats.maxRecursionDepth) {
+                stats.maxRecursionDepth = stats.recursionDepth;
+            }
+        }
+        ~PolyScopedDepth() {
+            PolyStats::forThisThread().recursionDepth --;
+        }
+};
+
+    #define POLY_COUNT_N(counter, n) (PolyStats::forThisThread().counters[PolyStats::counter] += (n))
+    #define POLY_TIME(timer) PolyScopedTimer polyScopedTimer(PolyStats::timer)
+    #define POLY_RECURSION() PolyScopedDepth polyScopedDepth
+
+#else
+
+    #define POLY_COUNT_N(counter, n) ((void) 0)
+    #define POLY_TIME(timer) ((void) 0)
+    #define POLY_RECURSION() ((void) 0)
+
+#endif
+
+#define POLY_COUNT(counter) POLY_COUNT_N(counter, 1)
+
+#endif //POLY_STATS_H
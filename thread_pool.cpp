@@ -0,0 +1,188 @@
+#include <algorithm>
+#include <cassert>
+#include <utility>
+
+#include "thread_pool.h"
+
+// Index of the queue of the worker running on this thread, threads outside
+// of any pool use the last queue
+static thread_local const ThreadPool* currentPool = nullptr;
+static thread_local unsigned currentQueue = 0;
+
+/*****************************************************************************\
+|*                                 ThreadPool                                *|
+\*****************************************************************************/
+
+ThreadPool::ThreadPool(unsigned nThreads) : queued(0) {
+    this->start(nThreads);
+}
+
+ThreadPool::~ThreadPool() {
+    this->stop();
+}
+
+ThreadPool& ThreadPool::global() {
+    static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+    return pool;
+}
+
+unsigned ThreadPool::numThreads() const {
+    return this->workers.size() + 1;
+}
+
+void ThreadPool::resize(unsigned nThreads) {
+    assert(this->queued.load() == 0);
+    this->stop();
+    this->start(nThreads);
+}
+
+void ThreadPool::start(unsigned nThreads) {
+    unsigned nWorkers = std::max(1u, nThreads) - 1;
+
+    this->stopping = false;
+    this->queues.clear();
+    for (unsigned i = 0; i <= nWorkers; i++) {
+        this->queues.emplace_back(new Queue);
+    }
+    for (unsigned i = 0; i < nWorkers; i++) {
+        this->workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+void ThreadPool::stop() {
+    {
+        std::lock_guard<std::mutex> lock(this->sleepMutex);
+        this->stopping = true;
+    }
+    this->wakeUp.notify_all();
+
+    for (std::thread& worker : this->workers) {
+        worker.join();
+    }
+    this->workers.clear();
+}
+
+void ThreadPool::push(Task task) {
+    unsigned index = currentPool == this ? currentQueue : this->workers.size();
+    Queue& queue = *this->queues[index];
+
+    // Counted before it can be popped, so that the decrement of a thief can't
+    // come first and wrap the count around
+    {
+        std::lock_guard<std::mutex> lock(this->sleepMutex);
+        this->queued ++;
+    }
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+    this->wakeUp.notify_one();
+}
+
+bool ThreadPool::tryPop(Task& task) {
+    unsigned nQueues = this->queues.size();
+    unsigned own = currentPool == this ? currentQueue : nQueues - 1;
+
+    {
+        Queue& queue = *this->queues[own];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (not queue.tasks.empty()) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+            this->queued --;
+            return true;
+        }
+    }
+
+    for (unsigned i = 1; i < nQueues; i++) {
+        Queue& queue = *this->queues[(own + i) % nQueues];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (not queue.tasks.empty()) {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            this->queued --;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool ThreadPool::tryRun() {
+    Task task;
+    if (not this->tryPop(task)) {
+        return false;
+    }
+
+    // The group can be gone as soon as pending reaches 0
+    try {
+        task.function();
+    } catch (...) {
+        task.group->fail(std::current_exception());
+    }
+    task.group->pending --;
+    return true;
+}
+
+void ThreadPool::workerLoop(unsigned index) {
+    currentPool = this;
+    currentQueue = index;
+
+    while (true) {
+        if (this->tryRun()) {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(this->sleepMutex);
+        this->wakeUp.wait(lock, [this]() {
+            return this->stopping or this->queued.load() != 0;
+        });
+        if (this->stopping) {
+            return;
+        }
+    }
+}
+
+/*****************************************************************************\
+|*                                 TaskGroup                                 *|
+\*****************************************************************************/
+
+TaskGroup::TaskGroup(ThreadPool& pool) : pool(pool), pending(0) {
+}
+
+TaskGroup::~TaskGroup() {
+    this->waitForTasks();
+}
+
+void TaskGroup::run(std::function<void()> function) {
+    this->pending ++;
+    this->pool.push({std::move(function), this});
+}
+
+void TaskGroup::wait() {
+    this->waitForTasks();
+
+    std::exception_ptr exception;
+    {
+        std::lock_guard<std::mutex> lock(this->errorMutex);
+        std::swap(exception, this->error);
+    }
+    if (exception) {
+        std::rethrow_exception(exception);
+    }
+}
+
+void TaskGroup::waitForTasks() {
+    while (this->pending.load() != 0) {
+        if (not this->pool.tryRun()) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void TaskGroup::fail(std::exception_ptr exception) {
+    std::lock_guard<std::mutex> lock(this->errorMutex);
+    if (not this->error) {
+        this->error = exception;
+    }
+}
@@ -0,0 +1,171 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class TaskGroup;
+
+// Work stealing pool for fork-join recursion. Each worker pushes and pops
+// the tasks it spawns at the back of its own queue, so it keeps working on
+// the smallest and most recent ones, and idle workers steal from the front
+// of the other queues where the biggest tasks are. Threads outside of the
+// pool push to a queue of their own that the workers steal from.
+class ThreadPool {
+    public:
+        // nThreads counts the thread waiting on the tasks, the pool starts
+        // nThreads - 1 workers
+        explicit ThreadPool(unsigned nThreads);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        // The pool used by the multiplication, one thread per core
+        static ThreadPool& global();
+
+        unsigned numThreads() const;
+
+        // Stops the workers and starts new ones, no task must be running
+        void resize(unsigned nThreads);
+
+    private:
+        friend class TaskGroup;
+
+        struct Task {
+            std::function<void()> function;
+            TaskGroup* group;
+        };
+
+        struct Queue {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+        };
+
+        void start(unsigned nThreads);
+        void stop();
+
+        void push(Task task);
+        // Pops from the queue of this thread then steals from the others
+        bool tryRun();
+        bool tryPop(Task& task);
+        void workerLoop(unsigned index);
+
+        // One queue per worker then the one of the outside threads
+        std::vector<std::unique_ptr<Queue>> queues;
+        std::vector<std::thread> workers;
+
+        std::atomic<unsigned> queued;
+        std::mutex sleepMutex;
+        std::condition_variable wakeUp;
+        bool stopping = false;
+};
+
+// Tasks that can be waited on together. wait() runs the pending tasks of
+// the pool instead of blocking, so tasks can spawn and wait on groups of
+// their own without starving the pool.
+class TaskGroup {
+    public:
+        explicit TaskGroup(ThreadPool& pool);
+        // Waits for the tasks, dropping their exception
+        ~TaskGroup();
+
+        void run(std::function<void()> function);
+        // Rethrows the first exception thrown by a task, once all of them
+        // are done
+        void wait();
+
+    private:
+        friend class ThreadPool;
+
+        void waitForTasks();
+        // Keeps the first exception, called before the task is counted done
+        void fail(std::exception_ptr exception);
+
+        ThreadPool& pool;
+        std::atomic<unsigned> pending;
+        std::mutex errorMutex;
+        std::exception_ptr error;
+};
+
+// Queue between the stages of a pipeline. The producers block while it is
+// full so a fast stage can't run ahead of a slow one by more than capacity
+// values.
+template<typename T>
+class BoundedQueue {
+    public:
+        explicit BoundedQueue(size_t capacity);
+
+        BoundedQueue(const BoundedQueue&) = delete;
+        BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+        // Blocks while the queue is full, returns false once it is closed
+        bool push(T value);
+        // Blocks while the queue is empty, returns false once it is closed
+        // and empty
+        bool pop(T& value);
+        // Wakes up the waiting threads, the queued values can still be popped
+        void close();
+
+    private:
+        std::mutex mutex;
+        std::condition_variable notFull;
+        std::condition_variable notEmpty;
+        std::deque<T> values;
+        size_t capacity;
+        bool closed = false;
+};
+
+// Templates definitions
+
+template<typename T>
+BoundedQueue<T>::BoundedQueue(size_t capacity) : capacity(capacity) {
+}
+
+template<typename T>
+bool BoundedQueue<T>::push(T value) {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->notFull.wait(lock, [this]() {
+        return this->closed or this->values.size() < this->capacity;
+    });
+    if (this->closed) {
+        return false;
+    }
+
+    this->values.push_back(std::move(value));
+    this->notEmpty.notify_one();
+    return true;
+}
+
+template<typename T>
+bool BoundedQueue<T>::pop(T& value) {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->notEmpty.wait(lock, [this]() {
+        return this->closed or not this->values.empty();
+    });
+    if (this->values.empty()) {
+        return false;
+    }
+
+    value = std::move(this->values.front());
+    this->values.pop_front();
+    this->notFull.notify_one();
+    return true;
+}
+
+template<typename T>
+void BoundedQueue<T>::close() {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->closed = true;
+    this->notFull.notify_all();
+    this->notEmpty.notify_all();
+}
+
+#endif //THREAD_POOL_H
@@ -0,0 +1,76 @@
+#include <algorithm>
+#include <cassert>
+
+#include "workspace.h"
+
+Workspace::Workspace() {
+}
+
+Workspace& Workspace::forThisThread() {
+    static thread_local Workspace workspace;
+    return workspace;
+}
+
+void Workspace::reserve(unsigned nBlocks) {
+    unsigned position;
+    if (this->findPosition(nBlocks, position)) {
+        return;
+    }
+
+    // The allocated blocks must stay where they are, the new chunk goes
+    // after them
+    if (this->used != 0) {
+        this->starts.push_back(this->capacity());
+        this->chunks.emplace_back(nBlocks);
+        return;
+    }
+
+    unsigned size = std::max(nBlocks, this->capacity());
+    this->chunks.clear();
+    this->starts.clear();
+    this->chunks.emplace_back(size);
+    this->starts.push_back(0);
+}
+
+Workspace::Block* Workspace::allocate(unsigned nBlocks) {
+    unsigned position;
+    bool found = this->findPosition(nBlocks, position);
+    assert(found);
+    (void) found;
+
+    unsigned chunk = this->chunkOf(position);
+    this->used = position + nBlocks;
+    return this->chunks[chunk].data() + (position - this->starts[chunk]);
+}
+
+unsigned Workspace::mark() const {
+    return this->used;
+}
+
+void Workspace::release(unsigned mark) {
+    assert(mark <= this->used);
+    this->used = mark;
+}
+
+unsigned Workspace::capacity() const {
+    return this->chunks.empty() ? 0 : this->starts.back() + this->chunks.back().size();
+}
+
+unsigned Workspace::chunkOf(unsigned position) const {
+    unsigned chunk = 0;
+    while (chunk + 1 < this->chunks.size() and this->starts[chunk + 1] <= position) {
+        chunk ++;
+    }
+    return chunk;
+}
+
+bool Workspace::findPosition(unsigned nBlocks, unsigned& position) const {
+    position = this->used;
+    for (unsigned chunk = this->chunkOf(position); chunk < this->chunks.size(); chunk++) {
+        position = std::max(position, this->starts[chunk]);
+        if (position + nBlocks <= this->starts[chunk] + this->chunks[chunk].size()) {
+            return true;
+        }
+    }
+    return false;
+}
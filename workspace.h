@@ -0,0 +1,50 @@
+#ifndef WORKSPACE_H
+#define WORKSPACE_H
+
+#include <vector>
+
+#include "poly.h"
+
+// Stack of scratch blocks for the recursive algorithms. It is sized up front
+// with reserve() then the recursion takes blocks with allocate() and gives
+// them back with release(). The storage is kept between calls so a loop of
+// multiplications stops allocating once the biggest one has been seen.
+// The storage is a chain of chunks, an allocation never straddles two of
+// them, so that growing it while blocks are in use doesn't move them.
+class Workspace {
+    public:
+        typedef Poly::Block Block;
+
+        Workspace();
+
+        // One workspace per thread, reused by all the multiplications
+        static Workspace& forThisThread();
+
+        // Makes sure nBlocks more blocks can be allocated at once. With
+        // blocks allocated a chunk is added, else the chunks are replaced
+        // by a single one as big as all of them.
+        void reserve(unsigned nBlocks);
+
+        // The blocks are not zeroed
+        Block* allocate(unsigned nBlocks);
+
+        // Releases everything allocated since mark was taken
+        unsigned mark() const;
+        void release(unsigned mark);
+
+        unsigned capacity() const;
+
+    private:
+        // The last chunk starting at or before the position
+        unsigned chunkOf(unsigned position) const;
+        // The position nBlocks would be allocated at, false if they don't
+        // fit in the chunks
+        bool findPosition(unsigned nBlocks, unsigned& position) const;
+
+        // Chunk i covers the positions [starts[i], starts[i] + size)
+        std::vector<std::vector<Block>> chunks;
+        std::vector<unsigned> starts;
+        unsigned used = 0;
+};
+
+#endif //WORKSPACE_H